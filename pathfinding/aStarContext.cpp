@@ -0,0 +1,132 @@
+#include "aStarContext.h"
+#include <algorithm>
+
+void AStarContext::begin_query(size_t w, size_t h)
+{
+  const size_t inpSize = w * h;
+  if (tiles.size() != inpSize)
+  {
+    tiles.assign(inpSize, TileState{});
+    closed.assign((inpSize + 63) / 64, 0);
+    closedGen.assign(closed.size(), 0);
+    gen = 0;
+  }
+  width = w;
+  height = h;
+  heap.clear();
+  numExpanded = 0;
+  numPushed = 0;
+  if (++gen == 0)
+  {
+    // generation counter wrapped, this is the only time we have to clear stamps
+    for (TileState &ts : tiles)
+      ts.gen = 0;
+    std::fill(closedGen.begin(), closedGen.end(), 0);
+    gen = 1;
+  }
+}
+
+bool AStarContext::prepare(size_t w, size_t h, size_t max_tiles)
+{
+  const size_t inpSize = w * h;
+  if (width * height != inpSize || tiles.size() > inpSize)
+  {
+    // reserved up front, so growing in parts never moves what's already there
+    tiles.clear();
+    tiles.reserve(inpSize);
+    closed.clear();
+    closedGen.clear();
+    width = w;
+    height = h;
+    gen = 0;
+  }
+  if (tiles.size() == inpSize)
+    return true;
+  tiles.resize(std::min(inpSize, tiles.size() + max_tiles));
+  if (tiles.size() < inpSize)
+    return false;
+  closed.assign((inpSize + 63) / 64, 0);
+  closedGen.assign(closed.size(), 0);
+  return true;
+}
+
+void AStarContext::push(uint32_t idx, float g, float f, uint32_t prev)
+{
+  TileState &ts = tiles[idx];
+  if (ts.gen != gen)
+  {
+    ts.gen = gen;
+    ts.heapIdx = invalid_idx;
+  }
+  ts.g = g;
+  ts.prev = prev;
+  numPushed++;
+  if (ts.heapIdx == invalid_idx)
+  {
+    ts.heapIdx = uint32_t(heap.size());
+    heap.push_back({f, idx});
+    sift_up(heap.size() - 1);
+    return;
+  }
+  // decrease key, f could only go down for the same target
+  heap[ts.heapIdx].f = f;
+  sift_up(ts.heapIdx);
+}
+
+uint32_t AStarContext::pop()
+{
+  const uint32_t res = heap.front().idx;
+  tiles[res].heapIdx = invalid_idx;
+  heap.front() = heap.back();
+  heap.pop_back();
+  if (!heap.empty())
+  {
+    tiles[heap.front().idx].heapIdx = 0;
+    sift_down(0);
+  }
+  return res;
+}
+
+size_t AStarContext::get_allocated_bytes() const
+{
+  return tiles.capacity() * sizeof(TileState) + heap.capacity() * sizeof(HeapNode) +
+         closed.capacity() * sizeof(uint64_t) + closedGen.capacity() * sizeof(uint32_t);
+}
+
+void AStarContext::sift_up(size_t pos)
+{
+  const HeapNode node = heap[pos];
+  while (pos > 0)
+  {
+    const size_t parent = (pos - 1) / 2;
+    if (heap[parent].f <= node.f)
+      break;
+    heap[pos] = heap[parent];
+    tiles[heap[pos].idx].heapIdx = uint32_t(pos);
+    pos = parent;
+  }
+  heap[pos] = node;
+  tiles[node.idx].heapIdx = uint32_t(pos);
+}
+
+void AStarContext::sift_down(size_t pos)
+{
+  const HeapNode node = heap[pos];
+  const size_t count = heap.size();
+  while (true)
+  {
+    size_t child = pos * 2 + 1;
+    if (child >= count)
+      break;
+    if (child + 1 < count && heap[child + 1].f < heap[child].f)
+      child++;
+    if (node.f <= heap[child].f)
+      break;
+    heap[pos] = heap[child];
+    tiles[heap[pos].idx].heapIdx = uint32_t(pos);
+    pos = child;
+  }
+  heap[pos] = node;
+  tiles[node.idx].heapIdx = uint32_t(pos);
+}
+
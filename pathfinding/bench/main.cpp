@@ -0,0 +1,337 @@
+#include "raylib.h"
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "math.h"
+#include "dungeonGen.h"
+#include "dungeonUtils.h"
+#include "pathfinder.h"
+#include "timeSlicedSearch.h"
+
+// Headless benchmark for the pathfinding algorithms, prints results as CSV.
+// usage: pathfinding_bench [queries_per_map]
+//        pathfinding_bench frames [agents] - frame times when all agents request paths at once
+//        pathfinding_bench grid [size] - char tiles against the bit packed walk grid on a large map
+
+struct BenchQuery
+{
+  Position from;
+  Position to;
+  float optimalCost;
+};
+
+struct BenchMap
+{
+  const char *kind;
+  std::vector<char> tiles;
+  size_t width;
+  size_t height;
+  unsigned seed;
+};
+
+struct QueryStats
+{
+  size_t numExpanded = 0;
+  size_t numPushed = 0;
+  size_t peakBytes = 0;
+};
+
+// drunk dungeons have water, cellular ones are open caverns with uniform cost
+static BenchMap gen_bench_map(const char *kind, size_t size, unsigned seed)
+{
+  BenchMap map{kind, std::vector<char>(size * size), size, size, seed};
+  if (strcmp(kind, "cellular") == 0)
+  {
+    gen_cellular_dungeon(map.tiles.data(), size, size, 0.45f, 10, seed);
+    return map;
+  }
+  gen_drunk_dungeon(map.tiles.data(), size, size, size / 8, size * 2, seed);
+  SetRandomSeed(seed);
+  spill_drunk_water(map.tiles.data(), size, size, size / 16, size / 4);
+  return map;
+}
+
+static float path_cost(const BenchMap &map, const std::vector<Position> &path)
+{
+  float cost = 0.f;
+  for (size_t i = 1; i < path.size(); ++i)
+    cost += map.tiles[coord_to_idx(path[i].x, path[i].y, map.width)] == dungeon::water ? 10.f : 1.f;
+  return cost;
+}
+
+static std::vector<BenchQuery> gen_queries(const BenchMap &map, AStarContext &ctx, size_t count)
+{
+  std::vector<Position> walkable;
+  for (size_t y = 0; y < map.height; ++y)
+    for (size_t x = 0; x < map.width; ++x)
+      if (map.tiles[coord_to_idx(x, y, map.width)] == dungeon::floor)
+        walkable.push_back(Position{int(x), int(y)});
+  // a map without floor has nothing to query, its batches report zero queries
+  if (walkable.empty())
+    return {};
+
+  std::mt19937 gen(map.seed);
+  std::uniform_int_distribution<size_t> dist(0, walkable.size() - 1);
+  std::vector<BenchQuery> res;
+  while (res.size() < count)
+  {
+    const Position from = walkable[dist(gen)];
+    const Position to = walkable[dist(gen)];
+    // reference cost comes from plain A*, euclidean heuristic is admissible here
+    std::vector<Position> path = find_path_a_star(ctx, map.tiles.data(), map.width, map.height, from, to, 1.f);
+    if (path.empty())
+      continue;
+    res.push_back({from, to, path_cost(map, path)});
+  }
+  return res;
+}
+
+template<typename Callable>
+static void run_batch(const BenchMap &map, const std::vector<BenchQuery> &queries, const char *algo, float weight, Callable find_path)
+{
+  size_t found = 0;
+  size_t totalExpanded = 0;
+  size_t totalPushed = 0;
+  size_t peakBytes = 0;
+  double sumSubopt = 0.0;
+  double maxSubopt = 0.0;
+  std::vector<float> costs(queries.size(), -1.f);
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < queries.size(); ++i)
+  {
+    QueryStats stats;
+    std::vector<Position> path = find_path(queries[i].from, queries[i].to, stats);
+    totalExpanded += stats.numExpanded;
+    totalPushed += stats.numPushed;
+    peakBytes = std::max(peakBytes, stats.peakBytes + path.capacity() * sizeof(Position));
+    if (!path.empty())
+      costs[i] = path_cost(map, path);
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (size_t i = 0; i < queries.size(); ++i)
+  {
+    if (costs[i] < 0.f)
+      continue;
+    found++;
+    const double subopt = queries[i].optimalCost > 0.f ? double(costs[i]) / double(queries[i].optimalCost) : 1.0;
+    sumSubopt += subopt;
+    maxSubopt = std::max(maxSubopt, subopt);
+  }
+  const double numQueries = double(std::max(queries.size(), size_t(1)));
+  printf("%s,%zu,%u,%s,%.2f,%zu,%zu,%.1f,%.1f,%.1f,%zu,%.4f,%.4f\n",
+         map.kind, map.width, map.seed, algo, double(weight), queries.size(), found,
+         seconds > 0.0 ? double(queries.size()) / seconds : 0.0,
+         double(totalExpanded) / numQueries,
+         double(totalPushed) / numQueries,
+         peakBytes,
+         found > 0 ? sumSubopt / double(found) : 0.0,
+         maxSubopt);
+  fflush(stdout);
+}
+
+// Every agent requests a path on the same frame. Blocking searches all run in that frame,
+// the queue spreads them over several frames with a fixed budget.
+static void run_frames(size_t num_agents)
+{
+  constexpr size_t sizes[] = {256, 1024};
+  constexpr size_t nodeBudgets[] = {20000, 100000};
+  constexpr uint64_t usBudget = 4000;
+  printf("size,agents,mode,nodes_per_frame,us_per_frame,frames,found,avg_frame_ms,max_frame_ms\n");
+  AStarContext ctx;
+  for (size_t size : sizes)
+  {
+    const BenchMap map = gen_bench_map("drunk", size, 1);
+    const std::vector<BenchQuery> queries = gen_queries(map, ctx, num_agents);
+    auto print = [&](const char *mode, size_t nodes, uint64_t us, size_t frames, size_t found, double sum_ms, double max_ms)
+    {
+      printf("%zu,%zu,%s,%zu,%" PRIu64 ",%zu,%zu,%.3f,%.3f\n", size, num_agents, mode, nodes, us, frames, found,
+             sum_ms / double(std::max(frames, size_t(1))), max_ms);
+      fflush(stdout);
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (const BenchQuery &q : queries)
+      found += !find_path_a_star(ctx, map.tiles.data(), map.width, map.height, q.from, q.to, 1.f).empty();
+    const double blockingMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    print("blocking", 0, 0, 1, found, blockingMs, blockingMs);
+
+    for (size_t nodes : nodeBudgets)
+    {
+      PathRequestQueue queue;
+      std::vector<size_t> ids;
+      for (const BenchQuery &q : queries)
+        ids.push_back(queue.request(AStarQuery{map.tiles.data(), map.width, map.height, q.from, q.to, 1.f, nullptr, nullptr}));
+      size_t frames = 0;
+      double sumMs = 0.0;
+      double maxMs = 0.0;
+      while (queue.get_num_active() > 0)
+      {
+        const auto frameStart = std::chrono::steady_clock::now();
+        queue.update(nodes, usBudget);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        frames++;
+        sumMs += ms;
+        maxMs = std::max(maxMs, ms);
+      }
+      found = 0;
+      for (size_t id : ids)
+        found += queue.get_status(id) == SearchStatus::Found;
+      print("sliced", nodes, usBudget, frames, found, sumMs, maxMs);
+    }
+  }
+}
+
+// A* reading char tiles or WalkGrid bits, same queries, also times the cellular generator
+static void run_walk_grid(size_t size)
+{
+  constexpr size_t numQueries = 10;
+  printf("size,mode,queries,queries_per_sec,avg_expanded,tiles_bytes,grid_bytes,build_ms,cellular_ms\n");
+  AStarContext ctx;
+  const BenchMap map = gen_bench_map("drunk", size, 1);
+  const std::vector<BenchQuery> queries = gen_queries(map, ctx, numQueries);
+
+  auto start = std::chrono::steady_clock::now();
+  WalkGrid grid;
+  grid.build(map.tiles.data(), map.width, map.height);
+  const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<char> cellular(size * size);
+  start = std::chrono::steady_clock::now();
+  gen_cellular_dungeon(cellular.data(), size, size, 0.45f, 10, 1);
+  const double cellularMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  for (bool useGrid : {false, true})
+  {
+    size_t totalExpanded = 0;
+    start = std::chrono::steady_clock::now();
+    for (const BenchQuery &q : queries)
+    {
+      find_path_a_star(ctx, map.tiles.data(), map.width, map.height, q.from, q.to, 1.f, nullptr, nullptr,
+                       useGrid ? &grid : nullptr);
+      totalExpanded += ctx.numExpanded;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu,%s,%zu,%.2f,%.1f,%zu,%zu,%.2f,%.2f\n", size, useGrid ? "walk_grid" : "char_tiles", queries.size(),
+           double(queries.size()) / seconds, double(totalExpanded) / double(queries.size()), map.tiles.size(),
+           grid.get_allocated_bytes(), buildMs, cellularMs);
+    fflush(stdout);
+  }
+}
+
+int main(int argc, const char **argv)
+{
+  if (argc > 1 && strcmp(argv[1], "frames") == 0)
+  {
+    run_frames(argc > 2 ? size_t(atoi(argv[2])) : 50);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "grid") == 0)
+  {
+    run_walk_grid(argc > 2 ? size_t(atoi(argv[2])) : 4096);
+    return 0;
+  }
+  const size_t numQueries = argc > 1 ? size_t(atoi(argv[1])) : 100;
+  constexpr size_t sizes[] = {128, 256, 512, 1024};
+  constexpr unsigned seeds[] = {1, 2};
+  const char *kinds[] = {"drunk", "cellular"};
+  constexpr float weights[] = {1.f, 1.5f, 2.f, 5.f};
+  constexpr size_t landmarkCounts[] = {4, 8, 16};
+  // IDA* is exponential in the number of distinct f values, keep it on small maps only
+  constexpr size_t idaMaxSize = 128;
+  constexpr size_t idaMaxQueries = 20;
+  constexpr size_t idaMaxExpanded = 2000000;
+
+  printf("map,size,seed,algo,weight,queries,found,queries_per_sec,avg_expanded,avg_pushed,peak_bytes,avg_suboptimality,max_suboptimality\n");
+  for (const char *kind : kinds)
+    for (size_t size : sizes)
+      for (unsigned seed : seeds)
+      {
+        // contexts never shrink, fresh ones per map so peak_bytes is this map's
+        AStarContext ctx;
+        // backward side of the bidirectional search
+        AStarContext backCtx;
+        const BenchMap map = gen_bench_map(kind, size, seed);
+        const std::vector<BenchQuery> queries = gen_queries(map, ctx, numQueries);
+
+        for (float weight : weights)
+          run_batch(map, queries, "a_star", weight, [&](Position from, Position to, QueryStats &stats)
+          {
+            std::vector<Position> path = find_path_a_star(ctx, map.tiles.data(), map.width, map.height, from, to, weight);
+            stats.numExpanded = ctx.numExpanded;
+            stats.numPushed = ctx.numPushed;
+            stats.peakBytes = ctx.get_allocated_bytes();
+            return path;
+          });
+
+        run_batch(map, queries, "bidir_a_star", 1.f, [&](Position from, Position to, QueryStats &stats)
+        {
+          std::vector<Position> path = find_path_bidirectional_a_star(ctx, backCtx, map.tiles.data(), map.width, map.height,
+                                                                      from, to);
+          stats.numExpanded = ctx.numExpanded + backCtx.numExpanded;
+          stats.numPushed = ctx.numPushed + backCtx.numPushed;
+          stats.peakBytes = ctx.get_allocated_bytes() + backCtx.get_allocated_bytes();
+          return path;
+        });
+
+        // ALT heuristic with different numbers of landmarks, table memory counts as peak memory
+        for (size_t numLandmarks : landmarkCounts)
+        {
+          LandmarkHeuristic landmarks;
+          landmarks.build(map.tiles.data(), map.width, map.height, numLandmarks);
+          char algo[32];
+          snprintf(algo, sizeof(algo), "a_star_alt%zu", numLandmarks);
+          run_batch(map, queries, algo, 1.f, [&](Position from, Position to, QueryStats &stats)
+          {
+            std::vector<Position> path = find_path_a_star(ctx, map.tiles.data(), map.width, map.height, from, to, 1.f,
+                                                          nullptr, &landmarks);
+            stats.numExpanded = ctx.numExpanded;
+            stats.numPushed = ctx.numPushed;
+            stats.peakBytes = ctx.get_allocated_bytes() + landmarks.get_allocated_bytes();
+            return path;
+          });
+        }
+
+        // falls back to A* on maps with water
+        WalkGrid grid;
+        grid.build(map.tiles.data(), map.width, map.height);
+        run_batch(map, queries, "jps", 1.f, [&](Position from, Position to, QueryStats &stats)
+        {
+          std::vector<Position> path = find_path_jps(ctx, map.tiles.data(), map.width, map.height, from, to, 1.f, grid);
+          stats.numExpanded = ctx.numExpanded;
+          stats.numPushed = ctx.numPushed;
+          stats.peakBytes = ctx.get_allocated_bytes();
+          return path;
+        });
+
+        FringeContext fringeCtx;
+        run_batch(map, queries, "fringe", 1.f, [&](Position from, Position to, QueryStats &stats)
+        {
+          FringeStats fringeStats;
+          std::vector<Position> path = find_fringe_path(fringeCtx, map.tiles.data(), map.width, map.height, from, to,
+                                                        &fringeStats);
+          stats.numExpanded = fringeStats.numExpanded;
+          stats.peakBytes = fringeCtx.get_allocated_bytes();
+          return path;
+        });
+
+        if (size > idaMaxSize)
+          continue;
+        const std::vector<BenchQuery> idaQueries(queries.begin(), queries.begin() + std::ptrdiff_t(std::min(queries.size(), idaMaxQueries)));
+        run_batch(map, idaQueries, "ida_star", 1.f, [&](Position from, Position to, QueryStats &stats)
+        {
+          IdaStarStats idaStats;
+          std::vector<Position> path = find_ida_star_path(map.tiles.data(), map.width, map.height, from, to,
+                                                          &idaStats, idaMaxExpanded);
+          stats.numExpanded = idaStats.numExpanded;
+          stats.peakBytes = idaStats.maxDepth * sizeof(Position);
+          return path;
+        });
+      }
+  return 0;
+}
@@ -1,8 +1,10 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
+#include "walkGrid.h"
 #include <cstring> // memset
 #include <cstdio> // printf
 #include <random>
+#include <vector>
 #include <chrono> // std::chrono
 #include <functional> // std::bind
 #include "math.h"
@@ -17,11 +19,20 @@ Position gen_random_dir()
 
 void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_excavations)
+{
+  unsigned seed = unsigned(std::chrono::system_clock::now().time_since_epoch().count() % std::numeric_limits<int>::max());
+  gen_drunk_dungeon(tiles, w, h, num_iter, max_excavations, seed);
+
+  for (size_t y = 0; y < h; ++y)
+    printf("%.*s\n", int(w), tiles + y * w);
+}
+
+void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
+                       const size_t num_iter, const size_t max_excavations, const unsigned seed)
 {
   memset(tiles, dungeon::wall, w * h);
 
   // generator
-  unsigned seed = unsigned(std::chrono::system_clock::now().time_since_epoch().count() % std::numeric_limits<int>::max());
   std::default_random_engine seedGenerator(seed);
   std::default_random_engine widthGenerator(seedGenerator());
   std::default_random_engine heightGenerator(seedGenerator());
@@ -88,9 +99,6 @@ void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
       tiles[size_t(pos.y) * w + size_t(pos.x)] = dungeon::floor;
     }
   }
-
-  for (size_t y = 0; y < h; ++y)
-    printf("%.*s\n", int(w), tiles + y * w);
 }
 
 void spill_drunk_water(char *tiles, const size_t w, const size_t h,
@@ -128,3 +136,48 @@ void spill_drunk_water(char *tiles, const size_t w, const size_t h,
   }
 }
 
+
+void run_cellular(char *tiles, const size_t w, const size_t h, const size_t num_iter)
+{
+  std::vector<char> scratch(tiles, tiles + w * h);
+  std::vector<uint8_t> walkable1(w);
+  std::vector<uint8_t> walkable2(w);
+  WalkGrid grid;
+  for (size_t iter = 0; iter < num_iter; ++iter)
+  {
+    // tiles out of the map count as walls, the same as unwalkable padding of the grid
+    grid.build(tiles, w, h);
+    bool hasChanges = false;
+    for (size_t y = 0; y < h; ++y)
+    {
+      grid.count_walkable_around_row(y, 1, walkable1.data());
+      grid.count_walkable_around_row(y, 2, walkable2.data());
+      for (size_t x = 0; x < w; ++x)
+      {
+        const size_t numWalls1 = 9 - walkable1[x];
+        const size_t numWalls2 = 25 - walkable2[x];
+
+        const bool shouldBeWall = numWalls1 >= 5 || numWalls2 < 1;
+        const bool shouldFlip = shouldBeWall != (tiles[y * w + x] == dungeon::wall);
+        if (shouldFlip)
+          scratch[y * w + x] = shouldBeWall ? dungeon::wall : dungeon::floor;
+        hasChanges |= shouldFlip;
+      }
+    }
+    memcpy(tiles, scratch.data(), w * h);
+    if (!hasChanges)
+      break;
+  }
+}
+
+void gen_cellular_dungeon(char *tiles, const size_t w, const size_t h, const float fillrate, const size_t num_iter,
+                          const unsigned seed)
+{
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dis(0.f, 1.f);
+  for (size_t y = 0; y < h; ++y)
+    for (size_t x = 0; x < w; ++x)
+      tiles[y * w + x] = dis(gen) < fillrate ? dungeon::wall : dungeon::floor;
+
+  run_cellular(tiles, w, h, num_iter);
+}
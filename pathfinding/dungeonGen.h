@@ -3,6 +3,14 @@
 
 void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_excavations);
+// deterministic version, doesn't print the result
+void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
+                       const size_t num_iter, const size_t max_excavations, const unsigned seed);
 
 void spill_drunk_water(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_spills);
+
+// open caverns without water, deterministic for the seed
+void gen_cellular_dungeon(char *tiles, const size_t w, const size_t h, const float fillrate, const size_t num_iter,
+                          const unsigned seed);
+void run_cellular(char *tiles, const size_t w, const size_t h, const size_t num_iter);
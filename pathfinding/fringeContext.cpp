@@ -0,0 +1,46 @@
+#include "fringeContext.h"
+
+void FringeContext::begin_query(size_t width, size_t height)
+{
+  const size_t inpSize = width * height + 1;
+  if (tiles.size() != inpSize)
+  {
+    tiles.assign(inpSize, TileState{});
+    gen = 0;
+  }
+  if (++gen == 0)
+  {
+    // generation counter wrapped, this is the only time we have to clear stamps
+    for (TileState &ts : tiles)
+      ts.gen = 0;
+    gen = 1;
+  }
+  head = uint32_t(inpSize - 1);
+  TileState &headState = touch(head);
+  headState.next = headState.prev = head;
+  fringeSize = 0;
+}
+
+void FringeContext::insert_after(uint32_t after, uint32_t idx)
+{
+  TileState &ts = touch(idx);
+  ts.next = tiles[after].next;
+  ts.prev = after;
+  tiles[ts.next].prev = idx;
+  tiles[after].next = idx;
+  fringeSize++;
+}
+
+void FringeContext::remove(uint32_t idx)
+{
+  TileState &ts = tiles[idx];
+  tiles[ts.prev].next = ts.next;
+  tiles[ts.next].prev = ts.prev;
+  ts.next = ts.prev = invalid_idx;
+  fringeSize--;
+}
+
+size_t FringeContext::get_allocated_bytes() const
+{
+  return tiles.capacity() * sizeof(TileState);
+}
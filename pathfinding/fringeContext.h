@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// State of Fringe Search which could be reused between queries on the same map, stamped
+// with generations like AStarContext. The fringe is an intrusive doubly linked list over tiles,
+// the node after the last tile is its head.
+class FringeContext
+{
+public:
+  static constexpr uint32_t invalid_idx = 0xffffffff;
+
+  // Starts new query on a map of given size with an empty fringe, reallocates only if the size has changed.
+  void begin_query(size_t width, size_t height);
+
+  float get_g(uint32_t idx) const { return tiles[idx].gen == gen ? tiles[idx].g : max_g; }
+  uint32_t get_parent(uint32_t idx) const { return tiles[idx].gen == gen ? tiles[idx].parent : invalid_idx; }
+  void set_g(uint32_t idx, float g, uint32_t parent)
+  {
+    TileState &ts = touch(idx);
+    ts.g = g;
+    ts.parent = parent;
+  }
+
+  uint32_t get_head() const { return head; }
+  uint32_t get_next(uint32_t idx) const { return tiles[idx].next; }
+  bool in_fringe(uint32_t idx) const { return tiles[idx].gen == gen && tiles[idx].next != invalid_idx; }
+  size_t get_fringe_size() const { return fringeSize; }
+  void insert_after(uint32_t after, uint32_t idx);
+  void remove(uint32_t idx);
+
+  size_t get_allocated_bytes() const;
+
+private:
+  static constexpr float max_g = 3.402823466e+38f;
+
+  struct TileState
+  {
+    uint32_t gen = 0;
+    uint32_t next = invalid_idx;
+    uint32_t prev = invalid_idx;
+    uint32_t parent = invalid_idx;
+    float g = max_g;
+  };
+
+  TileState &touch(uint32_t idx)
+  {
+    TileState &ts = tiles[idx];
+    if (ts.gen != gen)
+      ts = TileState{gen, invalid_idx, invalid_idx, invalid_idx, max_g};
+    return ts;
+  }
+
+  uint32_t gen = 0;
+  uint32_t head = 0;
+  size_t fringeSize = 0;
+  std::vector<TileState> tiles;
+};
@@ -0,0 +1,116 @@
+#include "landmarkHeuristic.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+
+constexpr uint32_t unreached = 0xffffffff;
+
+// Dijkstra with a bucket per distance (mod 11), edge costs are only 1 and 10.
+static void calc_distances(const char *tiles, size_t width, size_t height, size_t from,
+                             std::vector<uint32_t> &dist)
+{
+  constexpr size_t numBuckets = 11;
+  std::vector<size_t> buckets[numBuckets];
+  std::fill(dist.begin(), dist.end(), unreached);
+  dist[from] = 0;
+  buckets[0].push_back(from);
+  size_t numQueued = 1;
+  for (uint32_t d = 0; numQueued > 0; ++d)
+  {
+    std::vector<size_t> &bucket = buckets[d % numBuckets];
+    // 1 and 10 are never 0 mod 11, so the bucket doesn't grow while we iterate over it
+    for (size_t i = 0; i < bucket.size(); ++i)
+    {
+      const size_t cur = bucket[i];
+      if (dist[cur] != d)
+        continue; // stale entry, tile was reached with smaller distance
+      const size_t x = cur % width;
+      const size_t y = cur / width;
+      auto checkNeighbour = [&](size_t idx)
+      {
+        if (tiles[idx] == dungeon::wall)
+          return;
+        const uint32_t nd = d + (tiles[idx] == dungeon::water ? 10 : 1);
+        if (nd >= dist[idx])
+          return;
+        dist[idx] = nd;
+        buckets[nd % numBuckets].push_back(idx);
+        numQueued++;
+      };
+      if (x > 0)
+        checkNeighbour(cur - 1);
+      if (x + 1 < width)
+        checkNeighbour(cur + 1);
+      if (y > 0)
+        checkNeighbour(cur - width);
+      if (y + 1 < height)
+        checkNeighbour(cur + width);
+    }
+    numQueued -= bucket.size();
+    bucket.clear();
+  }
+}
+
+void LandmarkHeuristic::build(const char *tiles, size_t w, size_t h, size_t num_landmarks,
+                              const MapRegions *regions)
+{
+  width = w;
+  height = h;
+  const size_t numTiles = w * h;
+  landmarks.clear();
+  tileCost.resize(numTiles);
+  for (size_t i = 0; i < numTiles; ++i)
+    tileCost[i] = tiles[i] == dungeon::water ? 10 : 1;
+  std::vector<uint32_t> dist(numTiles);
+
+  // start from the largest region, landmarks in small pockets would be wasted
+  MapRegions ownRegions;
+  if (!regions)
+  {
+    ownRegions.build(tiles, w, h);
+    regions = &ownRegions;
+  }
+  std::vector<size_t> regionSizes;
+  size_t start = numTiles;
+  size_t largest = 0;
+  for (size_t i = 0; i < numTiles; ++i)
+  {
+    const uint32_t region = regions->get_region(i);
+    if (region == MapRegions::no_region)
+      continue;
+    if (region >= regionSizes.size())
+      regionSizes.resize(region + 1, 0);
+    if (++regionSizes[region] > largest)
+    {
+      largest = regionSizes[region];
+      start = i;
+    }
+  }
+  numLandmarks = start == numTiles ? 0 : num_landmarks;
+  distances.assign(numTiles * numLandmarks, unreachable);
+  if (numLandmarks == 0)
+    return;
+
+  // farthest point selection, each new landmark is the tile farthest from all previous ones
+  std::vector<uint32_t> minDist(numTiles, unreached);
+  calc_distances(tiles, w, h, start, dist);
+  size_t next = start;
+  for (size_t i = 0; i < numTiles; ++i)
+    if (dist[i] != unreached && dist[i] > dist[next])
+      next = i;
+  for (size_t l = 0; l < numLandmarks; ++l)
+  {
+    landmarks.push_back(next);
+    calc_distances(tiles, w, h, next, dist);
+    for (size_t i = 0; i < numTiles; ++i)
+    {
+      if (dist[i] == unreached)
+        continue;
+      // too far to fit into 16 bits is the same as unreachable, estimate just skips it
+      distances[i * numLandmarks + l] = uint16_t(std::min(dist[i], uint32_t(unreachable)));
+      minDist[i] = std::min(minDist[i], dist[i]);
+    }
+    for (size_t i = 0; i < numTiles; ++i)
+      if (minDist[i] != unreached && minDist[i] > minDist[next])
+        next = i;
+  }
+}
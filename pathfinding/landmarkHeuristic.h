@@ -0,0 +1,49 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mapRegions.h"
+
+// ALT (differential) heuristic: exact distances from a few landmark tiles, by the triangle
+// inequality |d(L, a) - d(L, b)| is a lower bound of d(a, b). Landmarks are picked in the
+// largest region, tiles of other regions are unreachable and give no estimate.
+// Distances are weighted by water and have to be rebuilt after tile edits. A move costs
+// as much as the tile we enter, so d(a, L) = d(L, a) - cost(a) + cost(L) gives the reverse bound.
+class LandmarkHeuristic
+{
+public:
+  static constexpr uint16_t unreachable = 0xffff;
+
+  // regions of tiles if the caller keeps them already, otherwise they're labeled here
+  void build(const char *tiles, size_t width, size_t height, size_t num_landmarks,
+             const MapRegions *regions = nullptr);
+
+  float get(size_t from_idx, size_t to_idx) const
+  {
+    const uint16_t *from = &distances[from_idx * numLandmarks];
+    const uint16_t *to = &distances[to_idx * numLandmarks];
+    const int costDiff = int(tileCost[to_idx]) - int(tileCost[from_idx]);
+    int res = 0;
+    for (size_t i = 0; i < numLandmarks; ++i)
+      if (from[i] != unreachable && to[i] != unreachable)
+      {
+        const int diff = int(to[i]) - int(from[i]);
+        res = std::max(res, std::max(diff, costDiff - diff));
+      }
+    return float(res);
+  }
+
+  size_t get_num_landmarks() const { return numLandmarks; }
+  size_t get_landmark(size_t i) const { return landmarks[i]; }
+  size_t get_allocated_bytes() const { return distances.capacity() * sizeof(uint16_t) + tileCost.capacity(); }
+
+private:
+  size_t width = 0;
+  size_t height = 0;
+  size_t numLandmarks = 0;
+  std::vector<size_t> landmarks;
+  // numLandmarks values per tile, so an estimate reads two short rows
+  std::vector<uint16_t> distances;
+  std::vector<uint8_t> tileCost;
+};
@@ -9,12 +9,8 @@
 #include "math.h"
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
-
-template<typename T>
-static size_t coord_to_idx(T x, T y, size_t w)
-{
-  return size_t(y) * w + size_t(x);
-}
+#include "pathfinder.h"
+#include "timeSlicedSearch.h"
 
 static void draw_nav_grid(const char *input, size_t width, size_t height)
 {
@@ -38,159 +34,27 @@ static void draw_path(std::vector<Position> path)
   }
 }
 
-static std::vector<Position> reconstruct_path(std::vector<Position> prev, Position to, size_t width)
-{
-  Position curPos = to;
-  std::vector<Position> res = {curPos};
-  while (prev[coord_to_idx(curPos.x, curPos.y, width)] != Position{-1, -1})
-  {
-    curPos = prev[coord_to_idx(curPos.x, curPos.y, width)];
-    res.insert(res.begin(), curPos);
-  }
-  return res;
-}
-
-float heuristic(Position lhs, Position rhs)
-{
-  return sqrtf(square(float(lhs.x - rhs.x)) + square(float(lhs.y - rhs.y)));
-};
-
-static float ida_star_search(const char *input, size_t width, size_t height, std::vector<Position> &path, const float g, const float bound, Position to)
-{
-  const Position &p = path.back();
-  const float f = g + heuristic(p, to);
-  if (f > bound)
-    return f;
-  if (p == to)
-    return -f;
-  float min = FLT_MAX;
-  auto checkNeighbour = [&](Position p) -> float
-  {
-    // out of bounds
-    if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
-      return 0.f;
-    size_t idx = coord_to_idx(p.x, p.y, width);
-    // not empty
-    if (input[idx] == '#')
-      return 0.f;
-    if (std::find(path.begin(), path.end(), p) != path.end())
-      return 0.f;
-    path.push_back(p);
-    float weight = input[idx] == 'o' ? 10.f : 1.f;
-    float gScore = g + 1.f * weight; // we're exactly 1 unit away
-    const float t = ida_star_search(input, width, height, path, gScore, bound, to);
-    if (t < 0.f)
-      return t;
-    if (t < min)
-      min = t;
-    path.pop_back();
-    return t;
-  };
-  float lv = checkNeighbour({p.x + 1, p.y + 0});
-  if (lv < 0.f) return lv;
-  float rv = checkNeighbour({p.x - 1, p.y + 0});
-  if (rv < 0.f) return rv;
-  float tv = checkNeighbour({p.x + 0, p.y + 1});
-  if (tv < 0.f) return tv;
-  float bv = checkNeighbour({p.x + 0, p.y - 1});
-  if (bv < 0.f) return bv;
-  return min;
-}
-
-static std::vector<Position> find_ida_star_path(const char *input, size_t width, size_t height, Position from, Position to)
-{
-  float bound = heuristic(from, to);
-  std::vector<Position> path = {from};
-  while (true)
-  {
-    const float t = ida_star_search(input, width, height, path, 0.f, bound, to);
-    if (t < 0.f)
-      return path;
-    if (t == FLT_MAX)
-      return {};
-    bound = t;
-    printf("new bound %0.1f\n", bound);
-  }
-  return {};
-}
-
-static std::vector<Position> find_path_a_star(const char *input, size_t width, size_t height, Position from, Position to, float weight)
+static void draw_expanded_nodes(const AStarContext &ctx, size_t width, size_t height)
 {
-  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
-    return std::vector<Position>();
-  size_t inpSize = width * height;
-
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<float> f(inpSize, std::numeric_limits<float>::max());
-  std::vector<Position> prev(inpSize, {-1,-1});
-
-  auto getG = [&](Position p) -> float { return g[coord_to_idx(p.x, p.y, width)]; };
-  auto getF = [&](Position p) -> float { return f[coord_to_idx(p.x, p.y, width)]; };
-
-  g[coord_to_idx(from.x, from.y, width)] = 0;
-  f[coord_to_idx(from.x, from.y, width)] = weight * heuristic(from, to);
-
-  std::vector<Position> openList = {from};
-  std::vector<Position> closedList;
-
-  while (!openList.empty())
-  {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
     {
-      float score = getF(openList[i]);
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
+      const uint32_t idx = uint32_t(coord_to_idx(x, y, width));
+      if (!ctx.is_closed(idx))
+        continue;
+      const float g = ctx.get_g(idx);
+      const Rectangle rect = {float(x), float(y), 1.f, 1.f};
+      DrawRectangleRec(rect, Color{uint8_t(g), uint8_t(g), 0, 100});
     }
-    if (openList[bestIdx] == to)
-      return reconstruct_path(prev, to, width);
-    Position curPos = openList[bestIdx];
-    openList.erase(openList.begin() + bestIdx);
-    if (std::find(closedList.begin(), closedList.end(), curPos) != closedList.end())
-      continue;
-    size_t idx = coord_to_idx(curPos.x, curPos.y, width);
-    const Rectangle rect = {float(curPos.x), float(curPos.y), 1.f, 1.f};
-    DrawRectangleRec(rect, Color{uint8_t(g[idx]), uint8_t(g[idx]), 0, 100});
-    closedList.emplace_back(curPos);
-    auto checkNeighbour = [&](Position p)
-    {
-      // out of bounds
-      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
-        return;
-      size_t idx = coord_to_idx(p.x, p.y, width);
-      // not empty
-      if (input[idx] == '#')
-        return;
-      float edgeWeight = input[idx] == 'o' ? 10.f : 1.f;
-      float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
-      if (gScore < getG(p))
-      {
-        prev[idx] = curPos;
-        g[idx] = gScore;
-        f[idx] = gScore + weight * heuristic(p, to);
-      }
-      bool found = std::find(openList.begin(), openList.end(), p) != openList.end();
-      if (!found)
-        openList.emplace_back(p);
-    };
-    checkNeighbour({curPos.x + 1, curPos.y + 0});
-    checkNeighbour({curPos.x - 1, curPos.y + 0});
-    checkNeighbour({curPos.x + 0, curPos.y + 1});
-    checkNeighbour({curPos.x + 0, curPos.y - 1});
-  }
-  // empty path
-  return std::vector<Position>();
 }
 
-void draw_nav_data(const char *input, size_t width, size_t height, Position from, Position to, float weight)
+void draw_nav_data(const AStarContext &ctx, const char *input, size_t width, size_t height,
+                   const std::vector<Position> &path, const AStarContext *back_ctx = nullptr)
 {
   draw_nav_grid(input, width, height);
-  std::vector<Position> path = find_path_a_star(input, width, height, from, to, weight);
-  //std::vector<Position> path = find_ida_star_path(input, width, height, from, to);
+  draw_expanded_nodes(ctx, width, height);
+  if (back_ctx)
+    draw_expanded_nodes(*back_ctx, width, height);
   draw_path(path);
 }
 
@@ -215,6 +79,23 @@ int main(int /*argc*/, const char ** /*argv*/)
   gen_drunk_dungeon(navGrid, dungWidth, dungHeight, 24, 100);
   spill_drunk_water(navGrid, dungWidth, dungHeight, 8, 10);
   float weight = 1.f;
+  bool useJps = false;
+  bool useBidirectional = false;
+  AStarContext aStarCtx;
+  AStarContext backCtx;
+  // time sliced search continues from the previous frame, it restarts only when the query changes
+  constexpr size_t nodesPerFrame = 200;
+  bool useSlicedSearch = true;
+  bool searchDirty = true;
+  TimeSlicedSearch slicedSearch;
+  MapRegions regions;
+  regions.build(navGrid, dungWidth, dungHeight);
+  WalkGrid walkGrid;
+  walkGrid.build(navGrid, dungWidth, dungHeight);
+  constexpr size_t numLandmarks = 8;
+  bool useLandmarks = false;
+  LandmarkHeuristic landmarks;
+  landmarks.build(navGrid, dungWidth, dungHeight, numLandmarks, &regions);
 
   Position from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
   Position to = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
@@ -233,39 +114,100 @@ int main(int /*argc*/, const char ** /*argv*/)
     {
       size_t idx = coord_to_idx(p.x, p.y, dungWidth);
       if (idx < dungWidth * dungHeight)
+      {
         navGrid[idx] = navGrid[idx] == ' ' ? '#' : navGrid[idx] == '#' ? 'o' : ' ';
+        regions.update(navGrid, {idx});
+        walkGrid.set_tile(idx % dungWidth, idx / dungWidth, navGrid[idx]);
+        landmarks.build(navGrid, dungWidth, dungHeight, numLandmarks, &regions);
+        searchDirty = true;
+      }
     }
     else if (IsMouseButtonPressed(0))
     {
       Position &target = from;
       target = p;
+      searchDirty = true;
     }
     else if (IsMouseButtonPressed(1))
     {
       Position &target = to;
       target = p;
+      searchDirty = true;
     }
     if (IsKeyPressed(KEY_SPACE))
     {
       gen_drunk_dungeon(navGrid, dungWidth, dungHeight, 24, 100);
       spill_drunk_water(navGrid, dungWidth, dungHeight, 8, 10);
+      regions.build(navGrid, dungWidth, dungHeight);
+      walkGrid.build(navGrid, dungWidth, dungHeight);
+      landmarks.build(navGrid, dungWidth, dungHeight, numLandmarks, &regions);
       from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
       to = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
+      searchDirty = true;
+    }
+    if (IsKeyPressed(KEY_T))
+    {
+      useSlicedSearch = !useSlicedSearch;
+      searchDirty = true;
+      printf("time sliced search %s\n", useSlicedSearch ? "on" : "off");
+    }
+    if (IsKeyPressed(KEY_J))
+    {
+      useJps = !useJps;
+      printf("jps %s\n", useJps ? "on" : "off");
+    }
+    if (IsKeyPressed(KEY_B))
+    {
+      useBidirectional = !useBidirectional;
+      printf("bidirectional a* %s\n", useBidirectional ? "on" : "off");
+    }
+    if (IsKeyPressed(KEY_L))
+    {
+      useLandmarks = !useLandmarks;
+      searchDirty = true;
+      printf("landmarks %s\n", useLandmarks ? "on" : "off");
     }
     if (IsKeyPressed(KEY_UP))
     {
       weight += 0.1f;
+      searchDirty = true;
       printf("new weight %f\n", weight);
     }
     if (IsKeyPressed(KEY_DOWN))
     {
       weight = std::max(1.f, weight - 0.1f);
+      searchDirty = true;
       printf("new weight %f\n", weight);
     }
+    const LandmarkHeuristic *heuristicTable = useLandmarks ? &landmarks : nullptr;
+    const AStarContext *shownCtx = &aStarCtx;
+    const AStarContext *shownBackCtx = nullptr;
+    std::vector<Position> path;
+    if (useJps)
+      path = find_path_jps(aStarCtx, navGrid, dungWidth, dungHeight, from, to, weight, walkGrid, &regions);
+    else if (useBidirectional)
+    {
+      path = find_path_bidirectional_a_star(aStarCtx, backCtx, navGrid, dungWidth, dungHeight, from, to, &regions);
+      shownBackCtx = &backCtx;
+    }
+    else if (useSlicedSearch)
+    {
+      if (searchDirty)
+        slicedSearch.start(AStarQuery{navGrid, dungWidth, dungHeight, from, to, weight, &regions, heuristicTable,
+                                      &walkGrid});
+      searchDirty = false;
+      slicedSearch.step(nodesPerFrame);
+      // partial path until the search is done
+      path = slicedSearch.get_path();
+      shownCtx = &slicedSearch.get_context();
+    }
+    else
+      path = find_path_a_star(aStarCtx, navGrid, dungWidth, dungHeight, from, to, weight, &regions, heuristicTable,
+                              &walkGrid);
     BeginDrawing();
       ClearBackground(BLACK);
       BeginMode2D(camera);
-        draw_nav_data(navGrid, dungWidth, dungHeight, from, to, weight);
+        draw_nav_data(*shownCtx, navGrid, dungWidth, dungHeight, path, shownBackCtx);
       EndMode2D();
     EndDrawing();
   }
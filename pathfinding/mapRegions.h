@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Connected components of walkable tiles (water is walkable, walls aren't),
+// used to reject queries between disconnected parts of the map without a search.
+// Raw labels are merged with union-find when walls are dug out, when a wall
+// splits a region only the smaller part is relabeled.
+class MapRegions
+{
+public:
+  static constexpr uint32_t no_region = 0xffffffff;
+
+  void build(const char *tiles, size_t width, size_t height);
+  // tiles should already contain new values
+  void update(const char *tiles, const std::vector<size_t> &changed_tiles);
+
+  // no_region for walls
+  uint32_t get_region(size_t idx) const { return labels[idx] == no_region ? no_region : find_root(labels[idx]); }
+  bool is_reachable(size_t from, size_t to) const
+  {
+    const uint32_t region = get_region(from);
+    return region != no_region && region == get_region(to);
+  }
+
+  size_t get_width() const { return width; }
+  size_t get_height() const { return height; }
+
+private:
+  uint32_t find_root(uint32_t label) const;
+  uint32_t new_label();
+  void add_tile(size_t idx);
+  void remove_tile(size_t idx);
+
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<uint32_t> labels;
+  mutable std::vector<uint32_t> parent;
+
+  // scratch for split detection, stamped the same way as AStarContext
+  std::vector<uint32_t> visitStamp;
+  uint32_t stamp = 0;
+  std::vector<size_t> splitQueues[4];
+};
+
@@ -0,0 +1,499 @@
+#include "pathfinder.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <float.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+float heuristic(Position lhs, Position rhs)
+{
+  return sqrtf(square(float(lhs.x - rhs.x)) + square(float(lhs.y - rhs.y)));
+};
+
+void append_path(const AStarContext &ctx, Position to, size_t width, std::vector<Position> &res)
+{
+  // written from the end, then the appended part is flipped in place
+  const size_t first = res.size();
+  uint32_t idx = uint32_t(coord_to_idx(to.x, to.y, width));
+  while (idx != AStarContext::invalid_idx)
+  {
+    res.push_back(Position{int(idx % width), int(idx / width)});
+    idx = ctx.get_prev(idx);
+  }
+  std::reverse(res.begin() + std::ptrdiff_t(first), res.end());
+}
+
+std::vector<Position> reconstruct_path(const AStarContext &ctx, Position to, size_t width)
+{
+  std::vector<Position> res;
+  append_path(ctx, to, width, res);
+  return res;
+}
+
+// exact distance on an open 4-connected grid with unit costs, much tighter than euclidean.
+// Admissible for any 4-connected moves costing at least 1, integer f values also
+// keep the number of IDA* and Fringe iterations low
+static float manhattan(Position lhs, Position rhs)
+{
+  return float(abs(lhs.x - rhs.x) + abs(lhs.y - rhs.y));
+}
+
+// one bit per tile, marks tiles on the current IDA* path
+class TileBitset
+{
+public:
+  explicit TileBitset(size_t size) : words((size + 63) / 64, 0) {}
+  bool test(size_t idx) const { return (words[idx >> 6] >> (idx & 63)) & 1; }
+  void set(size_t idx) { words[idx >> 6] |= uint64_t(1) << (idx & 63); }
+  void reset(size_t idx) { words[idx >> 6] &= ~(uint64_t(1) << (idx & 63)); }
+
+private:
+  std::vector<uint64_t> words;
+};
+
+static constexpr Position search_dirs[4] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+std::vector<Position> find_ida_star_path(const char *input, size_t width, size_t height, Position from, Position to,
+                                         IdaStarStats *stats, size_t max_expanded)
+{
+  IdaStarStats localStats;
+  IdaStarStats &st = stats ? *stats : localStats;
+  st = IdaStarStats{};
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
+    return {};
+
+  // explicit stack instead of recursion, long corridors would overflow the call stack
+  struct Frame
+  {
+    Position pos;
+    float g;
+    uint8_t nextDir;
+  };
+  std::vector<Frame> stack;
+  TileBitset onPath(width * height);
+  float bound = manhattan(from, to);
+  while (true)
+  {
+    float minExceeded = FLT_MAX;
+    bool found = false;
+    // returns false if the tile isn't going to be searched further
+    auto enter = [&](Position p, float g)
+    {
+      st.numExpanded++;
+      const float f = g + manhattan(p, to);
+      if (f > bound)
+      {
+        minExceeded = std::min(minExceeded, f);
+        return false;
+      }
+      stack.push_back({p, g, 0});
+      st.maxDepth = std::max(st.maxDepth, stack.size());
+      onPath.set(coord_to_idx(p.x, p.y, width));
+      found = p == to;
+      return true;
+    };
+    stack.clear();
+    enter(from, 0.f);
+    while (!stack.empty() && !found && st.numExpanded <= max_expanded)
+    {
+      Frame &top = stack.back();
+      if (top.nextDir == 4)
+      {
+        onPath.reset(coord_to_idx(top.pos.x, top.pos.y, width));
+        stack.pop_back();
+        continue;
+      }
+      const Position p{top.pos.x + search_dirs[top.nextDir].x, top.pos.y + search_dirs[top.nextDir].y};
+      top.nextDir++;
+      // out of bounds
+      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
+        continue;
+      const size_t idx = coord_to_idx(p.x, p.y, width);
+      // not empty or already on the path
+      if (input[idx] == dungeon::wall || onPath.test(idx))
+        continue;
+      const float weight = input[idx] == dungeon::water ? 10.f : 1.f;
+      enter(p, top.g + 1.f * weight); // we're exactly 1 unit away
+    }
+    if (found)
+    {
+      std::vector<Position> path;
+      path.reserve(stack.size());
+      for (const Frame &frame : stack)
+        path.push_back(frame.pos);
+      return path;
+    }
+    if (st.numExpanded > max_expanded || minExceeded == FLT_MAX)
+      return {};
+    // onPath is clean again, every frame has been popped
+    bound = minExceeded;
+  }
+}
+
+std::vector<Position> find_fringe_path(FringeContext &ctx, const char *input, size_t width, size_t height,
+                                       Position from, Position to, FringeStats *stats)
+{
+  FringeStats localStats;
+  FringeStats &st = stats ? *stats : localStats;
+  st = FringeStats{};
+  ctx.begin_query(width, height);
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
+    return {};
+  if (to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height))
+    return {};
+
+  const uint32_t head = ctx.get_head();
+  auto insertAfter = [&](uint32_t after, uint32_t idx)
+  {
+    ctx.insert_after(after, idx);
+    st.maxFringeSize = std::max(st.maxFringeSize, ctx.get_fringe_size());
+  };
+
+  const uint32_t fromIdx = uint32_t(coord_to_idx(from.x, from.y, width));
+  const uint32_t toIdx = uint32_t(coord_to_idx(to.x, to.y, width));
+  ctx.set_g(fromIdx, 0.f, FringeContext::invalid_idx);
+  insertAfter(head, fromIdx);
+  float limit = manhattan(from, to);
+  while (ctx.get_fringe_size() > 0)
+  {
+    float minExceeded = FLT_MAX;
+    uint32_t cur = ctx.get_next(head);
+    while (cur != head)
+    {
+      const Position curPos{int(cur % width), int(cur / width)};
+      const float curG = ctx.get_g(cur);
+      const float f = curG + manhattan(curPos, to);
+      if (f > limit)
+      {
+        // stays in the fringe for the next iteration
+        minExceeded = std::min(minExceeded, f);
+        cur = ctx.get_next(cur);
+        continue;
+      }
+      if (cur == toIdx)
+      {
+        std::vector<Position> path;
+        for (uint32_t idx = toIdx; idx != FringeContext::invalid_idx; idx = ctx.get_parent(idx))
+          path.push_back(Position{int(idx % width), int(idx / width)});
+        std::reverse(path.begin(), path.end());
+        return path;
+      }
+      st.numExpanded++;
+      // children go right after the current tile so they are visited in this iteration,
+      // in reverse so the first direction comes first
+      for (size_t dir = 4; dir-- > 0;)
+      {
+        const Position p{curPos.x + search_dirs[dir].x, curPos.y + search_dirs[dir].y};
+        if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
+          continue;
+        const uint32_t idx = uint32_t(coord_to_idx(p.x, p.y, width));
+        if (input[idx] == dungeon::wall)
+          continue;
+        const float gScore = curG + (input[idx] == dungeon::water ? 10.f : 1.f);
+        if (gScore >= ctx.get_g(idx))
+          continue;
+        if (ctx.in_fringe(idx))
+          ctx.remove(idx);
+        insertAfter(cur, idx);
+        ctx.set_g(idx, gScore, cur);
+      }
+      const uint32_t next = ctx.get_next(cur);
+      ctx.remove(cur);
+      cur = next;
+    }
+    limit = minExceeded;
+  }
+  // empty path
+  return {};
+}
+
+static float a_star_estimate(const AStarQuery &query, Position p, uint32_t idx)
+{
+  const float h = heuristic(p, query.to);
+  if (!query.landmarks)
+    return h;
+  return std::max(h, query.landmarks->get(idx, coord_to_idx(query.to.x, query.to.y, query.width)));
+}
+
+bool begin_a_star(AStarContext &ctx, const AStarQuery &query)
+{
+  const Position from = query.from;
+  const Position to = query.to;
+  ctx.begin_query(query.width, query.height);
+  if (from.x < 0 || from.y < 0 || from.x >= int(query.width) || from.y >= int(query.height))
+    return false;
+  if (to.x < 0 || to.y < 0 || to.x >= int(query.width) || to.y >= int(query.height))
+    return false;
+  if (query.regions &&
+      !query.regions->is_reachable(coord_to_idx(from.x, from.y, query.width), coord_to_idx(to.x, to.y, query.width)))
+    return false;
+
+  const uint32_t fromIdx = uint32_t(coord_to_idx(from.x, from.y, query.width));
+  ctx.push(fromIdx, 0.f, query.weight * a_star_estimate(query, from, fromIdx), AStarContext::invalid_idx);
+  return true;
+}
+
+void expand_a_star_node(AStarContext &ctx, const AStarQuery &query, uint32_t cur_idx)
+{
+  const size_t width = query.width;
+  const size_t height = query.height;
+  ctx.close(cur_idx);
+  ctx.numExpanded++;
+  const Position curPos{int(cur_idx % width), int(cur_idx / width)};
+  const float curG = ctx.get_g(cur_idx);
+  auto checkNeighbour = [&](Position p)
+  {
+    // out of bounds
+    if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
+      return;
+    const uint32_t idx = uint32_t(coord_to_idx(p.x, p.y, width));
+    // not empty
+    const bool walkable = query.walkGrid ? query.walkGrid->is_walkable(p.x, p.y) : query.input[idx] != dungeon::wall;
+    if (!walkable || ctx.is_closed(idx))
+      return;
+    const bool water = query.walkGrid ? query.walkGrid->is_expensive(p.x, p.y) : query.input[idx] == dungeon::water;
+    float edgeWeight = water ? 10.f : 1.f;
+    float gScore = curG + 1.f * edgeWeight; // we're exactly 1 unit away
+    if (gScore < ctx.get_g(idx))
+      ctx.push(idx, gScore, gScore + query.weight * a_star_estimate(query, p, idx), cur_idx);
+  };
+  checkNeighbour({curPos.x + 1, curPos.y + 0});
+  checkNeighbour({curPos.x - 1, curPos.y + 0});
+  checkNeighbour({curPos.x + 0, curPos.y + 1});
+  checkNeighbour({curPos.x + 0, curPos.y - 1});
+}
+
+std::vector<Position> find_path_a_star(AStarContext &ctx, const char *input, size_t width, size_t height,
+                                       Position from, Position to, float weight,
+                                       const MapRegions *regions, const LandmarkHeuristic *landmarks,
+                                       const WalkGrid *walk_grid)
+{
+  const AStarQuery query{input, width, height, from, to, weight, regions, landmarks, walk_grid};
+  if (!begin_a_star(ctx, query))
+    return std::vector<Position>();
+
+  const uint32_t toIdx = uint32_t(coord_to_idx(to.x, to.y, width));
+  while (!ctx.empty())
+  {
+    const uint32_t curIdx = ctx.pop();
+    if (curIdx == toIdx)
+      return reconstruct_path(ctx, to, width);
+    expand_a_star_node(ctx, query, curIdx);
+  }
+  // empty path
+  return std::vector<Position>();
+}
+
+static float tile_cost(char tile)
+{
+  return tile == dungeon::water ? 10.f : 1.f;
+}
+
+// Searches one side of the bidirectional A*. A move costs as much as the tile we enter,
+// so backwards from v to its neighbour u the cost is cost(v), not cost(u).
+static void expand_bidirectional_node(AStarContext &ctx, const AStarContext &other, const char *input,
+                                      size_t width, size_t height, Position from, Position to, bool backward,
+                                      uint32_t cur_idx, float &best_cost, uint32_t &meet_idx)
+{
+  ctx.close(cur_idx);
+  ctx.numExpanded++;
+  const Position curPos{int(cur_idx % width), int(cur_idx / width)};
+  const float curG = ctx.get_g(cur_idx);
+  const float backwardCost = tile_cost(input[cur_idx]);
+  for (const Position &dir : search_dirs)
+  {
+    const Position p{curPos.x + dir.x, curPos.y + dir.y};
+    if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
+      continue;
+    const uint32_t idx = uint32_t(coord_to_idx(p.x, p.y, width));
+    if (input[idx] == dungeon::wall || ctx.is_closed(idx))
+      continue;
+    const float gScore = curG + (backward ? backwardCost : tile_cost(input[idx]));
+    if (gScore >= ctx.get_g(idx))
+      continue;
+    // average potential, negated for the backward side
+    const float potential = 0.5f * (heuristic(p, to) - heuristic(p, from));
+    ctx.push(idx, gScore, gScore + (backward ? -potential : potential), cur_idx);
+    if (other.is_visited(idx) && gScore + other.get_g(idx) < best_cost)
+    {
+      best_cost = gScore + other.get_g(idx);
+      meet_idx = idx;
+    }
+  }
+}
+
+std::vector<Position> find_path_bidirectional_a_star(AStarContext &fwd_ctx, AStarContext &bwd_ctx, const char *input,
+                                                     size_t width, size_t height, Position from, Position to,
+                                                     const MapRegions *regions)
+{
+  fwd_ctx.begin_query(width, height);
+  bwd_ctx.begin_query(width, height);
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
+    return std::vector<Position>();
+  if (to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height))
+    return std::vector<Position>();
+  const uint32_t fromIdx = uint32_t(coord_to_idx(from.x, from.y, width));
+  const uint32_t toIdx = uint32_t(coord_to_idx(to.x, to.y, width));
+  // plain A* never enters a wall, it could only start in one
+  if (input[toIdx] == dungeon::wall)
+    return std::vector<Position>();
+  if (regions && !regions->is_reachable(fromIdx, toIdx))
+    return std::vector<Position>();
+
+  const float startPotential = 0.5f * heuristic(from, to);
+  fwd_ctx.push(fromIdx, 0.f, startPotential, AStarContext::invalid_idx);
+  bwd_ctx.push(toIdx, 0.f, startPotential, AStarContext::invalid_idx);
+  float bestCost = FLT_MAX;
+  uint32_t meetIdx = fromIdx == toIdx ? fromIdx : AStarContext::invalid_idx;
+  if (fromIdx == toIdx)
+    bestCost = 0.f;
+  // keys of both sides are reduced by the same potential, their sum bounds any path not found yet
+  while (!fwd_ctx.empty() && !bwd_ctx.empty() && fwd_ctx.top_f() + bwd_ctx.top_f() < bestCost)
+  {
+    // the side with the smaller frontier is cheaper to grow
+    if (fwd_ctx.get_open_size() <= bwd_ctx.get_open_size())
+      expand_bidirectional_node(fwd_ctx, bwd_ctx, input, width, height, from, to, false, fwd_ctx.pop(),
+                                bestCost, meetIdx);
+    else
+      expand_bidirectional_node(bwd_ctx, fwd_ctx, input, width, height, from, to, true, bwd_ctx.pop(),
+                                bestCost, meetIdx);
+  }
+  if (meetIdx == AStarContext::invalid_idx)
+    return std::vector<Position>();
+
+  std::vector<Position> res = reconstruct_path(fwd_ctx, Position{int(meetIdx % width), int(meetIdx / width)}, width);
+  for (uint32_t idx = bwd_ctx.get_prev(meetIdx); idx != AStarContext::invalid_idx; idx = bwd_ctx.get_prev(idx))
+    res.push_back(Position{int(idx % width), int(idx / width)});
+  return res;
+}
+
+static bool is_passable(const char *input, size_t width, size_t height, int x, int y)
+{
+  return x >= 0 && y >= 0 && x < int(width) && y < int(height) && input[coord_to_idx(x, y, width)] != dungeon::wall;
+}
+
+// Walks from p in (dx, dy) direction until it finds a tile which has to be expanded.
+// Horizontal walks stop where a side opens up, vertical walks also stop
+// where any horizontal walk from them would stop. Returns false if it hits a wall.
+static bool jump(const char *input, size_t width, size_t height, Position p, int dx, int dy, Position to, Position &res)
+{
+  auto passable = [&](int x, int y) { return is_passable(input, width, height, x, y); };
+  while (true)
+  {
+    p = Position{p.x + dx, p.y + dy};
+    if (!passable(p.x, p.y))
+      return false;
+    res = p;
+    if (p == to)
+      return true;
+    if (dx != 0)
+    {
+      if ((passable(p.x, p.y - 1) && !passable(p.x - dx, p.y - 1)) ||
+          (passable(p.x, p.y + 1) && !passable(p.x - dx, p.y + 1)))
+        return true;
+      continue;
+    }
+    if ((passable(p.x - 1, p.y) && !passable(p.x - 1, p.y - dy)) ||
+        (passable(p.x + 1, p.y) && !passable(p.x + 1, p.y - dy)))
+      return true;
+    Position sideRes;
+    if (jump(input, width, height, p, 1, 0, to, sideRes) || jump(input, width, height, p, -1, 0, to, sideRes))
+      return true;
+  }
+}
+
+static int sign(int v)
+{
+  return (v > 0) - (v < 0);
+}
+
+// jump points are connected with straight lines, fill the tiles between them
+static std::vector<Position> reconstruct_jps_path(const AStarContext &ctx, Position to, size_t width)
+{
+  std::vector<Position> res;
+  uint32_t idx = uint32_t(coord_to_idx(to.x, to.y, width));
+  res.push_back(to);
+  while (ctx.get_prev(idx) != AStarContext::invalid_idx)
+  {
+    const uint32_t prevIdx = ctx.get_prev(idx);
+    const Position prev{int(prevIdx % width), int(prevIdx / width)};
+    Position p = res.back();
+    const int dx = sign(prev.x - p.x);
+    const int dy = sign(prev.y - p.y);
+    while (p != prev)
+    {
+      p = Position{p.x + dx, p.y + dy};
+      res.push_back(p);
+    }
+    idx = prevIdx;
+  }
+  std::reverse(res.begin(), res.end());
+  return res;
+}
+
+std::vector<Position> find_path_jps(AStarContext &ctx, const char *input, size_t width, size_t height,
+                                    Position from, Position to, float weight, const WalkGrid &walk_grid,
+                                    const MapRegions *regions)
+{
+  if (walk_grid.has_expensive_tiles())
+    return find_path_a_star(ctx, input, width, height, from, to, weight, regions, nullptr, &walk_grid);
+
+  ctx.begin_query(width, height);
+  if (!is_passable(input, width, height, from.x, from.y) || !is_passable(input, width, height, to.x, to.y))
+    return std::vector<Position>();
+  if (regions && !regions->is_reachable(coord_to_idx(from.x, from.y, width), coord_to_idx(to.x, to.y, width)))
+    return std::vector<Position>();
+
+  const uint32_t toIdx = uint32_t(coord_to_idx(to.x, to.y, width));
+  ctx.push(uint32_t(coord_to_idx(from.x, from.y, width)), 0.f, weight * manhattan(from, to), AStarContext::invalid_idx);
+
+  while (!ctx.empty())
+  {
+    const uint32_t curIdx = ctx.pop();
+    if (curIdx == toIdx)
+      return reconstruct_jps_path(ctx, to, width);
+    ctx.close(curIdx);
+    ctx.numExpanded++;
+    const Position curPos{int(curIdx % width), int(curIdx / width)};
+    const float curG = ctx.get_g(curIdx);
+    auto checkDirection = [&](int dx, int dy)
+    {
+      Position jp;
+      if (!jump(input, width, height, curPos, dx, dy, to, jp))
+        return;
+      const uint32_t idx = uint32_t(coord_to_idx(jp.x, jp.y, width));
+      if (ctx.is_closed(idx))
+        return;
+      const float gScore = curG + manhattan(jp, curPos);
+      if (gScore < ctx.get_g(idx))
+        ctx.push(idx, gScore, gScore + weight * manhattan(jp, to), curIdx);
+    };
+    const uint32_t prevIdx = ctx.get_prev(curIdx);
+    if (prevIdx == AStarContext::invalid_idx)
+    {
+      checkDirection(1, 0);
+      checkDirection(-1, 0);
+      checkDirection(0, 1);
+      checkDirection(0, -1);
+      continue;
+    }
+    // natural neighbours only, we never need to go back
+    const int dx = sign(curPos.x - int(prevIdx % width));
+    const int dy = sign(curPos.y - int(prevIdx / width));
+    if (dx != 0)
+    {
+      checkDirection(dx, 0);
+      checkDirection(0, 1);
+      checkDirection(0, -1);
+    }
+    else
+    {
+      checkDirection(0, dy);
+      checkDirection(1, 0);
+      checkDirection(-1, 0);
+    }
+  }
+  // empty path
+  return std::vector<Position>();
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "math.h"
+#include "aStarContext.h"
+#include "fringeContext.h"
+#include "mapRegions.h"
+#include "landmarkHeuristic.h"
+#include "walkGrid.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+template<typename T>
+inline size_t coord_to_idx(T x, T y, size_t w)
+{
+  return size_t(y) * w + size_t(x);
+}
+
+float heuristic(Position lhs, Position rhs);
+
+// with regions queries between disconnected tiles return right away without a search,
+// with landmarks the heuristic is the max of euclidean and ALT estimates,
+// with walk_grid tiles are read from its bits instead of input
+std::vector<Position> find_path_a_star(AStarContext &ctx, const char *input, size_t width, size_t height,
+                                       Position from, Position to, float weight,
+                                       const MapRegions *regions = nullptr,
+                                       const LandmarkHeuristic *landmarks = nullptr,
+                                       const WalkGrid *walk_grid = nullptr);
+
+// Pieces of find_path_a_star, for searches which don't run to the end in one go
+struct AStarQuery
+{
+  const char *input;
+  size_t width;
+  size_t height;
+  Position from;
+  Position to;
+  float weight;
+  const MapRegions *regions;
+  const LandmarkHeuristic *landmarks;
+  const WalkGrid *walkGrid = nullptr;
+};
+// begins a query in ctx and pushes the start, false if there's nothing to search
+bool begin_a_star(AStarContext &ctx, const AStarQuery &query);
+// closes the tile and pushes its neighbours
+void expand_a_star_node(AStarContext &ctx, const AStarQuery &query, uint32_t cur_idx);
+// Appends the path from the start of the last search in ctx to `to`, prev links are read
+// straight from ctx, nothing but res is allocated
+void append_path(const AStarContext &ctx, Position to, size_t width, std::vector<Position> &res);
+std::vector<Position> reconstruct_path(const AStarContext &ctx, Position to, size_t width);
+
+// Bidirectional A*, forward search from `from` in fwd_ctx and backward search from `to` in bwd_ctx.
+// Both use the average of the two euclidean estimates as a potential, so their keys are consistent
+// with each other and the search stops when the best meeting cost is not above the sum of the two
+// smallest keys. Optimal with water, no weight since an inflated estimate breaks the stop rule.
+std::vector<Position> find_path_bidirectional_a_star(AStarContext &fwd_ctx, AStarContext &bwd_ctx, const char *input,
+                                                     size_t width, size_t height, Position from, Position to,
+                                                     const MapRegions *regions = nullptr);
+
+// 4-connected Jump Point Search with manhattan heuristic, only jump points go to the open list. Falls back to
+// find_path_a_star when the map has weighted tiles, output is the same full tile path.
+// walk_grid is built from input, it tells if there are any weighted tiles without a scan of the map.
+std::vector<Position> find_path_jps(AStarContext &ctx, const char *input, size_t width, size_t height,
+                                    Position from, Position to, float weight, const WalkGrid &walk_grid,
+                                    const MapRegions *regions = nullptr);
+
+struct IdaStarStats
+{
+  size_t numExpanded = 0;
+  size_t maxDepth = 0;
+};
+
+// Iterative, memory is the path plus one bit per tile. Uses manhattan heuristic.
+// max_expanded limits the total work, search gives up with an empty path when it's exceeded
+std::vector<Position> find_ida_star_path(const char *input, size_t width, size_t height, Position from, Position to,
+                                         IdaStarStats *stats = nullptr, size_t max_expanded = SIZE_MAX);
+
+struct FringeStats
+{
+  size_t numExpanded = 0;
+  size_t maxFringeSize = 0;
+};
+
+// Fringe Search: IDA* which keeps the frontier and g values between iterations
+// instead of searching from the start again, no priority queue.
+// With ctx reused between queries nothing is allocated once it's sized for the map.
+std::vector<Position> find_fringe_path(FringeContext &ctx, const char *input, size_t width, size_t height,
+                                       Position from, Position to, FringeStats *stats = nullptr);
+
@@ -0,0 +1,211 @@
+#include "timeSlicedSearch.h"
+#include <algorithm>
+#include <chrono>
+
+void TimeSlicedSearch::start(const AStarQuery &q)
+{
+  query = q;
+  status = begin_a_star(ctx, query) ? SearchStatus::InProgress : SearchStatus::NotFound;
+  bestIdx = status == SearchStatus::InProgress ? uint32_t(coord_to_idx(q.from.x, q.from.y, q.width))
+                                               : AStarContext::invalid_idx;
+  bestH = heuristic(q.from, q.to);
+}
+
+SearchStatus TimeSlicedSearch::step(size_t max_nodes, uint64_t max_us)
+{
+  if (status != SearchStatus::InProgress)
+    return status;
+  const auto start = std::chrono::steady_clock::now();
+  const uint32_t toIdx = uint32_t(coord_to_idx(query.to.x, query.to.y, query.width));
+  for (size_t i = 0; i < max_nodes; ++i)
+  {
+    if (ctx.empty())
+    {
+      status = SearchStatus::NotFound;
+      break;
+    }
+    // reading the clock isn't free, check it every few expansions
+    if (max_us != UINT64_MAX && (i & 31) == 31 &&
+        uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()) >= max_us)
+      break;
+    const uint32_t curIdx = ctx.pop();
+    if (curIdx == toIdx)
+    {
+      status = SearchStatus::Found;
+      bestIdx = curIdx;
+      break;
+    }
+    const Position curPos{int(curIdx % query.width), int(curIdx / query.width)};
+    const float h = heuristic(curPos, query.to);
+    if (h < bestH)
+    {
+      bestH = h;
+      bestIdx = curIdx;
+    }
+    expand_a_star_node(ctx, query, curIdx);
+  }
+  return status;
+}
+
+void TimeSlicedSearch::get_path(std::vector<Position> &res) const
+{
+  if (status == SearchStatus::NotFound || bestIdx == AStarContext::invalid_idx)
+    return;
+  append_path(ctx, Position{int(bestIdx % query.width), int(bestIdx / query.width)}, query.width, res);
+}
+
+std::vector<Position> TimeSlicedSearch::get_path() const
+{
+  std::vector<Position> res;
+  get_path(res);
+  return res;
+}
+
+size_t PathRequestQueue::request(const AStarQuery &query)
+{
+  size_t id = requests.size();
+  if (!freeRequests.empty())
+  {
+    id = freeRequests.back();
+    freeRequests.pop_back();
+  }
+  else
+    requests.emplace_back();
+  Request &req = requests[id];
+  req.query = query;
+  req.status = SearchStatus::InProgress;
+  req.searchIdx = invalid_idx;
+  req.path.clear();
+  pending.push_back(id);
+  return id;
+}
+
+void PathRequestQueue::release(size_t id)
+{
+  Request &req = requests[id];
+  auto pendingIt = std::find(pending.begin(), pending.end(), id);
+  if (pendingIt != pending.end())
+    pending.erase(pendingIt);
+  auto activeIt = std::find(active.begin(), active.end(), id);
+  if (activeIt != active.end())
+  {
+    const size_t pos = size_t(activeIt - active.begin());
+    active.erase(activeIt);
+    if (pos < nextActive)
+      nextActive--;
+    if (nextActive >= active.size())
+      nextActive = 0;
+    freeSearches.push_back(req.searchIdx);
+  }
+  req.status = SearchStatus::NotFound;
+  req.searchIdx = invalid_idx;
+  req.path = std::vector<Position>();
+  freeRequests.push_back(id);
+}
+
+void PathRequestQueue::get_path(size_t id, std::vector<Position> &res) const
+{
+  const Request &req = requests[id];
+  if (req.searchIdx != invalid_idx)
+    searches[req.searchIdx]->get_path(res);
+  else
+    res.insert(res.end(), req.path.begin(), req.path.end());
+}
+
+std::vector<Position> PathRequestQueue::get_path(size_t id) const
+{
+  std::vector<Position> res;
+  get_path(id, res);
+  return res;
+}
+
+static uint64_t elapsed_us(std::chrono::steady_clock::time_point start)
+{
+  return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+void PathRequestQueue::admit_pending(std::chrono::steady_clock::time_point start, uint64_t us_per_frame)
+{
+  while (!pending.empty() && elapsed_us(start) < us_per_frame)
+  {
+    if (freeSearches.empty())
+    {
+      if (searches.size() >= maxConcurrent)
+        break;
+      freeSearches.push_back(searches.size());
+      searches.push_back(std::make_unique<TimeSlicedSearch>());
+    }
+    // a search which isn't sized for the map yet stays free and is prepared further next frame
+    const size_t searchIdx = freeSearches.back();
+    TimeSlicedSearch &search = *searches[searchIdx];
+    Request &req = requests[pending.front()];
+    bool prepared = search.prepare(req.query, prepare_tiles);
+    while (!prepared && elapsed_us(start) < us_per_frame)
+      prepared = search.prepare(req.query, prepare_tiles);
+    if (!prepared)
+      break;
+    freeSearches.pop_back();
+    const size_t id = pending.front();
+    pending.pop_front();
+    search.start(req.query);
+    if (search.get_status() != SearchStatus::InProgress)
+    {
+      // nothing to search, don't occupy the slot
+      req.status = search.get_status();
+      freeSearches.push_back(searchIdx);
+      continue;
+    }
+    req.searchIdx = searchIdx;
+    active.push_back(id);
+  }
+}
+
+void PathRequestQueue::update(size_t nodes_per_frame, uint64_t us_per_frame)
+{
+  const auto start = std::chrono::steady_clock::now();
+  admit_pending(start, us_per_frame);
+  size_t budget = nodes_per_frame;
+  while (budget > 0 && !active.empty())
+  {
+    // budget left by searches which finished early goes around again
+    const size_t slice = std::max(budget / active.size(), size_t(1));
+    size_t processed = 0;
+    for (; processed < active.size() && budget > 0; ++processed)
+    {
+      const uint64_t elapsed = elapsed_us(start);
+      if (elapsed >= us_per_frame)
+      {
+        budget = 0;
+        break;
+      }
+      TimeSlicedSearch &search = *searches[requests[active[(nextActive + processed) % active.size()]].searchIdx];
+      const size_t expandedBefore = search.get_context().numExpanded;
+      search.step(std::min(slice, budget), us_per_frame == UINT64_MAX ? UINT64_MAX : us_per_frame - elapsed);
+      budget -= std::min(budget, std::max(search.get_context().numExpanded - expandedBefore, size_t(1)));
+    }
+    // next frame starts where this one stopped, finished searches leave the round
+    const size_t resumeAt = (nextActive + processed) % active.size();
+    size_t numKept = 0;
+    size_t newNext = 0;
+    for (size_t i = 0; i < active.size(); ++i)
+    {
+      if (i == resumeAt)
+        newNext = numKept;
+      Request &req = requests[active[i]];
+      TimeSlicedSearch &search = *searches[req.searchIdx];
+      if (search.get_status() == SearchStatus::InProgress)
+      {
+        active[numKept++] = active[i];
+        continue;
+      }
+      req.status = search.get_status();
+      req.path.clear();
+      search.get_path(req.path);
+      freeSearches.push_back(req.searchIdx);
+      req.searchIdx = invalid_idx;
+    }
+    active.resize(numKept);
+    nextActive = numKept > 0 ? newNext % numKept : 0;
+    admit_pending(start, us_per_frame);
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "math.h"
+#include "aStarContext.h"
+#include "pathfinder.h"
+
+enum class SearchStatus
+{
+  InProgress,
+  Found,
+  NotFound
+};
+
+// A* which could be stopped after any expansion and continued later.
+// Map is read by pointer, it shouldn't change while the search is in progress.
+class TimeSlicedSearch
+{
+public:
+  // allocates state for the query's map, a part per call, true once start won't allocate
+  bool prepare(const AStarQuery &query, size_t max_tiles) { return ctx.prepare(query.width, query.height, max_tiles); }
+  void start(const AStarQuery &query);
+  // Expands at most max_nodes tiles and stops earlier if max_us microseconds have passed.
+  SearchStatus step(size_t max_nodes, uint64_t max_us = UINT64_MAX);
+
+  SearchStatus get_status() const { return status; }
+  // Full path if found, otherwise path to the expanded tile closest to the goal.
+  std::vector<Position> get_path() const;
+  // the same, appended to res
+  void get_path(std::vector<Position> &res) const;
+
+  const AStarContext &get_context() const { return ctx; }
+
+private:
+  AStarContext ctx;
+  AStarQuery query{};
+  SearchStatus status = SearchStatus::NotFound;
+  uint32_t bestIdx = AStarContext::invalid_idx;
+  float bestH = 0.f;
+};
+
+// Searches of all agents share one per frame budget, each update gives every active
+// search an equal slice and starts from a different one, so nobody starves.
+// Every search owns map sized state, so only max_concurrent of them run at once,
+// other requests wait in FIFO order. Finished requests keep just their path.
+// Requests are started by update and charged to its budget, state for a new search
+// is allocated a part at a time, so it's spread over frames instead of stalling one.
+class PathRequestQueue
+{
+public:
+  explicit PathRequestQueue(size_t max_concurrent = 8) : maxConcurrent(max_concurrent) {}
+
+  size_t request(const AStarQuery &query);
+  // frees the request, its id could be given to a later request
+  void release(size_t id);
+
+  // Spends up to nodes_per_frame expansions and us_per_frame microseconds.
+  void update(size_t nodes_per_frame, uint64_t us_per_frame = UINT64_MAX);
+
+  // waiting requests are InProgress too
+  SearchStatus get_status(size_t id) const { return requests[id].status; }
+  // partial path while the search is running, empty while it waits
+  std::vector<Position> get_path(size_t id) const;
+  void get_path(size_t id, std::vector<Position> &res) const;
+  size_t get_num_active() const { return active.size() + pending.size(); }
+
+private:
+  struct Request
+  {
+    AStarQuery query{};
+    SearchStatus status = SearchStatus::NotFound;
+    size_t searchIdx = invalid_idx;
+    std::vector<Position> path;
+  };
+  static constexpr size_t invalid_idx = ~size_t(0);
+  // tiles of search state allocated between reads of the clock
+  static constexpr size_t prepare_tiles = 1 << 16;
+
+  // starts waiting requests until us_per_frame has passed since start
+  void admit_pending(std::chrono::steady_clock::time_point start, uint64_t us_per_frame);
+
+  size_t maxConcurrent;
+  std::vector<Request> requests;
+  std::vector<size_t> freeRequests;
+  std::vector<std::unique_ptr<TimeSlicedSearch>> searches;
+  std::vector<size_t> freeSearches;
+  std::deque<size_t> pending;
+  // requests being searched, update goes around them
+  std::vector<size_t> active;
+  size_t nextActive = 0;
+};
@@ -0,0 +1,131 @@
+#include "walkGrid.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <bit>
+
+void WalkGrid::build(const char *tiles, size_t w, size_t h)
+{
+  width = w;
+  height = h;
+  // padding word on the left, at least one on the right, whole cache lines
+  wordsPerRow = ((w + 63) / 64 + 2 + 7) / 8 * 8;
+  walkable.assign((h + 2 * border) * wordsPerRow, 0);
+  expensive.assign(walkable.size(), 0);
+  numExpensive = 0;
+  for (size_t y = 0; y < h; ++y)
+  {
+    const char *row = tiles + y * w;
+    uint64_t *walkableRow = &walkable[row_offset(y) + 1];
+    uint64_t *expensiveRow = &expensive[row_offset(y) + 1];
+    // a word at a time, so it's accumulated in a register
+    for (size_t x = 0; x < w; x += 64)
+    {
+      const size_t count = std::min(w - x, size_t(64));
+      uint64_t walkableBits = 0;
+      uint64_t expensiveBits = 0;
+      for (size_t i = 0; i < count; ++i)
+      {
+        walkableBits |= uint64_t(row[x + i] != dungeon::wall) << i;
+        expensiveBits |= uint64_t(row[x + i] == dungeon::water) << i;
+      }
+      walkableRow[x >> 6] = walkableBits;
+      expensiveRow[x >> 6] = expensiveBits;
+      numExpensive += size_t(std::popcount(expensiveBits));
+    }
+  }
+}
+
+void WalkGrid::set_tile(size_t x, size_t y, char tile)
+{
+  assign(walkable, row_offset(y), x, tile != dungeon::wall);
+  numExpensive -= size_t(test(expensive, x, y));
+  assign(expensive, row_offset(y), x, tile == dungeon::water);
+  numExpensive += size_t(test(expensive, x, y));
+}
+
+void WalkGrid::assign(Words &words, size_t offset, size_t x, bool value)
+{
+  uint64_t &word = words[offset + (x >> 6) + 1];
+  const uint64_t bit = uint64_t(1) << (x & 63);
+  word = value ? word | bit : word & ~bit;
+}
+
+size_t WalkGrid::count_walkable_in_row(size_t y, size_t x_from, size_t x_to) const
+{
+  if (x_from >= x_to)
+    return 0;
+  const uint64_t *row = get_row(y) + 1;
+  const size_t firstWord = x_from >> 6;
+  const size_t lastWord = (x_to - 1) >> 6;
+  const uint64_t firstMask = ~uint64_t(0) << (x_from & 63);
+  const uint64_t lastMask = ~uint64_t(0) >> (63 - ((x_to - 1) & 63));
+  if (firstWord == lastWord)
+    return size_t(std::popcount(row[firstWord] & firstMask & lastMask));
+  size_t res = size_t(std::popcount(row[firstWord] & firstMask));
+  for (size_t i = firstWord + 1; i < lastWord; ++i)
+    res += size_t(std::popcount(row[i]));
+  return res + size_t(std::popcount(row[lastWord] & lastMask));
+}
+
+size_t WalkGrid::find_walkable_in_row(size_t y, size_t x) const
+{
+  if (x >= width)
+    return width;
+  const uint64_t *row = get_row(y) + 1;
+  const size_t numWords = (width + 63) / 64;
+  uint64_t word = row[x >> 6] & (~uint64_t(0) << (x & 63));
+  for (size_t i = x >> 6; i < numWords; word = row[++i])
+    if (word != 0)
+      return i * 64 + size_t(std::countr_zero(word));
+  return width;
+}
+
+size_t WalkGrid::count_walkable_around(size_t x, size_t y, size_t radius) const
+{
+  const uint64_t mask = (uint64_t(1) << (2 * radius + 1)) - 1;
+  // bit position in the padded row, the left padding word keeps it from going negative
+  const size_t bit = x + 64 - radius;
+  const size_t word = bit >> 6;
+  const size_t shift = bit & 63;
+  size_t res = 0;
+  for (size_t yy = y + border - radius; yy <= y + border + radius; ++yy)
+  {
+    const uint64_t *row = &walkable[yy * wordsPerRow + word];
+    // window could cross a word boundary, the right padding word is always there to read
+    const uint64_t bits = shift == 0 ? row[0] : (row[0] >> shift) | (row[1] << (64 - shift));
+    res += size_t(std::popcount(bits & mask));
+  }
+  return res;
+}
+
+void WalkGrid::count_walkable_around_row(size_t y, size_t radius, uint8_t *counts) const
+{
+  const uint64_t *rows[2 * border + 1];
+  for (size_t i = 0; i <= 2 * radius; ++i)
+    rows[i] = &walkable[(y + border - radius + i) * wordsPerRow];
+  // column c of the window is the tile x = c - radius, bit 64 + x of the padded rows
+  auto column = [&](size_t c)
+  {
+    const size_t bit = c + 64 - radius;
+    uint8_t res = 0;
+    for (size_t i = 0; i <= 2 * radius; ++i)
+      res += uint8_t((rows[i][bit >> 6] >> (bit & 63)) & 1);
+    return res;
+  };
+  // last 2 * radius + 1 column sums
+  uint8_t ring[8] = {};
+  uint32_t sum = 0;
+  for (size_t c = 0; c < 2 * radius; ++c)
+  {
+    ring[c & 7] = column(c);
+    sum += ring[c & 7];
+  }
+  for (size_t x = 0; x < width; ++x)
+  {
+    const size_t c = x + 2 * radius;
+    ring[c & 7] = column(c);
+    sum += ring[c & 7];
+    counts[x] = uint8_t(sum);
+    sum -= ring[x & 7];
+  }
+}
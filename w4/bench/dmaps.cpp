@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "ecsTypes.h"
+#include "dungeonUtils.h"
+#include "dijkstraMapGen.h"
+
+// Headless check of the dijkstra maps which are repaired between turns. Every turn the player
+// and creatures walk, some die and spawn, the player teleports now and then, then each map is
+// updated and built from scratch and the two are compared bit by bit. Prints results as CSV,
+// exits with 1 if any map differs.
+// usage: hw4_dmap_bench [turns]
+
+struct BenchWorld
+{
+  DungeonData dd;
+  OccupancyGrid occupancy;
+  std::vector<uint32_t> walkable;
+};
+
+// a long drunk walk from the middle, all floor is connected
+static BenchWorld gen_bench_world(size_t size, unsigned seed)
+{
+  std::vector<char> tiles(size * size, dungeon::wall);
+  std::mt19937 rng(seed);
+  size_t x = size / 2;
+  size_t y = size / 2;
+  for (size_t numFloor = 0; numFloor < size * size / 2;)
+  {
+    char &tile = tiles[y * size + x];
+    if (tile == dungeon::wall)
+    {
+      tile = dungeon::floor;
+      numFloor++;
+    }
+    const unsigned dir = rng() % 4;
+    x = std::clamp(x + (dir == 0) - (dir == 1), size_t(1), size - 2);
+    y = std::clamp(y + (dir == 2) - (dir == 3), size_t(1), size - 2);
+  }
+  BenchWorld world{DungeonData{tiles, size, size, {}}, {}, {}};
+  world.dd.walkGrid.build(tiles.data(), size, size);
+  world.occupancy.init(size, size);
+  for (size_t i = 0; i < tiles.size(); ++i)
+    if (tiles[i] != dungeon::wall)
+      world.walkable.push_back(uint32_t(i));
+  return world;
+}
+
+struct MapStats
+{
+  double updateMs = 0.0;
+  double maxUpdateMs = 0.0;
+  double fullMs = 0.0;
+  double maxFullMs = 0.0;
+  size_t changed = 0;
+  size_t badTiles = 0;
+  size_t badTurns = 0;
+  float maxDiff = 0.f;
+};
+
+static void compare_maps(const std::vector<float> &updated, const std::vector<float> &full, MapStats &stats)
+{
+  size_t numBad = 0;
+  for (size_t i = 0; i < full.size(); ++i)
+    if (std::memcmp(&updated[i], &full[i], sizeof(float)) != 0)
+    {
+      numBad++;
+      stats.maxDiff = std::max(stats.maxDiff, std::abs(updated[i] - full[i]));
+    }
+  stats.badTiles += numBad;
+  stats.badTurns += numBad > 0;
+}
+
+static double get_ms(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+  return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static void add_time(double update_ms, double full_ms, MapStats &stats)
+{
+  stats.updateMs += update_ms;
+  stats.maxUpdateMs = std::max(stats.maxUpdateMs, update_ms);
+  stats.fullMs += full_ms;
+  stats.maxFullMs = std::max(stats.maxFullMs, full_ms);
+}
+
+static bool run_scenario(size_t size, size_t num_creatures, size_t num_turns)
+{
+  BenchWorld world = gen_bench_world(size, 1);
+  std::mt19937 rng(2);
+  auto find_free_tile = [&]()
+  {
+    for (;;)
+    {
+      const uint32_t idx = world.walkable[rng() % world.walkable.size()];
+      if (!world.occupancy.is_occupied(size_t(idx)))
+        return idx;
+    }
+  };
+  auto add = [&](uint32_t idx) { world.occupancy.add(int(idx % size), int(idx / size)); };
+  auto move = [&](uint32_t &idx, uint32_t to)
+  {
+    world.occupancy.move(int(idx % size), int(idx / size), int(to % size), int(to / size));
+    idx = to;
+  };
+  auto step = [&](uint32_t &idx)
+  {
+    const int x = int(idx % size);
+    const int y = int(idx / size);
+    const unsigned dir = unsigned(rng() % 5); // or stay
+    const int nx = x + (dir == 0) - (dir == 1);
+    const int ny = y + (dir == 2) - (dir == 3);
+    if (world.dd.walkGrid.is_walkable(nx, ny) && !world.occupancy.is_occupied(nx, ny))
+      move(idx, uint32_t(size_t(ny) * size + size_t(nx)));
+  };
+
+  uint32_t player = find_free_tile();
+  add(player);
+  std::vector<uint32_t> creatures;
+  std::vector<bool> isHive;
+  for (size_t i = 0; i < num_creatures; ++i)
+  {
+    creatures.push_back(find_free_tile());
+    add(creatures.back());
+    isHive.push_back(rng() % 4 == 0);
+  }
+
+  IncrementalDmap approachDmap, fleeDmap, hiveDmap;
+  std::vector<float> approachMap, fleeMap, hiveMap;
+  std::vector<float> fullApproachMap, fullFleeMap, fullHiveMap;
+  std::vector<uint32_t> playerSources, hiveSources;
+  MapStats approachStats, fleeStats, hiveStats, allStats;
+  for (size_t turn = 0; turn < num_turns; ++turn)
+  {
+    if (turn > 0)
+    {
+      step(player);
+      for (uint32_t &idx : creatures)
+        step(idx);
+      if (rng() % 4 == 0 && !creatures.empty())
+      {
+        const size_t i = rng() % creatures.size();
+        world.occupancy.remove(int(creatures[i] % size), int(creatures[i] / size));
+        creatures.erase(creatures.begin() + std::ptrdiff_t(i));
+        isHive.erase(isHive.begin() + std::ptrdiff_t(i));
+      }
+      if (rng() % 4 == 0)
+      {
+        creatures.push_back(find_free_tile());
+        add(creatures.back());
+        isHive.push_back(rng() % 3 == 0);
+      }
+      // a source far away changes the whole map
+      if (rng() % 20 == 0)
+        move(player, find_free_tile());
+    }
+    playerSources.assign(1, player);
+    hiveSources.clear();
+    for (size_t i = 0; i < creatures.size(); ++i)
+      if (isHive[i])
+        hiveSources.push_back(creatures[i]);
+
+    const auto start = std::chrono::steady_clock::now();
+    dmaps::update_sources_map(world.dd, world.occupancy, playerSources, approachMap, approachDmap);
+    const auto approachUpdated = std::chrono::steady_clock::now();
+    dmaps::update_flee_map(world.dd, world.occupancy, approachMap, approachDmap, fleeMap, fleeDmap);
+    const auto fleeUpdated = std::chrono::steady_clock::now();
+    dmaps::update_sources_map(world.dd, world.occupancy, hiveSources, hiveMap, hiveDmap);
+    const auto hiveUpdated = std::chrono::steady_clock::now();
+    dmaps::gen_sources_map(world.dd, world.occupancy, playerSources, fullApproachMap);
+    const auto approachBuilt = std::chrono::steady_clock::now();
+    dmaps::gen_flee_map(world.dd, world.occupancy, fullApproachMap, fullFleeMap);
+    const auto fleeBuilt = std::chrono::steady_clock::now();
+    dmaps::gen_sources_map(world.dd, world.occupancy, hiveSources, fullHiveMap);
+    const auto hiveBuilt = std::chrono::steady_clock::now();
+
+    // the first update is a full build too
+    if (turn > 0)
+    {
+      add_time(get_ms(start, approachUpdated), get_ms(hiveUpdated, approachBuilt), approachStats);
+      add_time(get_ms(approachUpdated, fleeUpdated), get_ms(approachBuilt, fleeBuilt), fleeStats);
+      add_time(get_ms(fleeUpdated, hiveUpdated), get_ms(fleeBuilt, hiveBuilt), hiveStats);
+      add_time(get_ms(start, hiveUpdated), get_ms(hiveUpdated, hiveBuilt), allStats);
+      approachStats.changed += approachDmap.get_changed_tiles().size();
+      fleeStats.changed += fleeDmap.get_changed_tiles().size();
+      hiveStats.changed += hiveDmap.get_changed_tiles().size();
+      allStats.changed += approachDmap.get_changed_tiles().size() + fleeDmap.get_changed_tiles().size() +
+                          hiveDmap.get_changed_tiles().size();
+    }
+    compare_maps(approachMap, fullApproachMap, approachStats);
+    compare_maps(fleeMap, fullFleeMap, fleeStats);
+    compare_maps(hiveMap, fullHiveMap, hiveStats);
+  }
+  for (const MapStats *stats : {&approachStats, &fleeStats, &hiveStats})
+  {
+    allStats.badTiles += stats->badTiles;
+    allStats.badTurns += stats->badTurns;
+    allStats.maxDiff = std::max(allStats.maxDiff, stats->maxDiff);
+  }
+
+  const double turns = double(num_turns - 1);
+  auto print = [&](const char *name, const MapStats &stats)
+  {
+    printf("%zu,%zu,%s,%zu,%.3f,%.3f,%.3f,%.3f,%.0f,%zu,%zu,%g\n", size, num_creatures, name, num_turns,
+           stats.updateMs / turns, stats.maxUpdateMs, stats.fullMs / turns, stats.maxFullMs,
+           double(stats.changed) / turns, stats.badTurns, stats.badTiles, double(stats.maxDiff));
+  };
+  print("approach", approachStats);
+  print("flee", fleeStats);
+  print("hive", hiveStats);
+  print("all", allStats);
+  return allStats.badTiles == 0;
+}
+
+int main(int argc, const char **argv)
+{
+  const size_t numTurns = std::max(argc > 1 ? size_t(atoi(argv[1])) : 200, size_t(2));
+  constexpr size_t sizes[] = {50, 128, 256};
+  constexpr size_t creatureCounts[] = {0, 100, 400};
+
+  printf("size,creatures,map,turns,avg_update_ms,max_update_ms,avg_full_ms,max_full_ms,changed_per_turn,"
+         "bad_turns,bad_tiles,max_diff\n");
+  bool same = true;
+  for (size_t size : sizes)
+    for (size_t numCreatures : creatureCounts)
+    {
+      // half of the map is floor, leave room to walk
+      if (numCreatures * 3 > size * size / 2)
+        continue;
+      same &= run_scenario(size, numCreatures, numTurns);
+    }
+  return same ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#include "ecsTypes.h"
+#include "coopMover.h"
+#include "cooperativePlanner.h"
+
+void process_coop_movers(flecs::world &ecs)
+{
+  static auto processMovers = ecs.query<const Position, const MoveGoal, Action>();
+  static auto dungeonDataQuery = ecs.query<const DungeonData, const OccupancyGrid>();
+  static CooperativePlanner planner;
+  static std::vector<CoopAgent> agents;
+
+  dungeonDataQuery.each([&](const DungeonData &dd, const OccupancyGrid &occupancy)
+  {
+    agents.clear();
+    processMovers.each([&](const Position &pos, const MoveGoal &goal, Action &)
+    {
+      agents.push_back(CoopAgent{pos, Position{goal.x, goal.y}});
+    });
+    if (agents.empty())
+      return;
+    planner.plan(dd, occupancy, agents);
+    size_t i = 0;
+    ecs.defer([&]
+    {
+      processMovers.each([&](flecs::entity entity, const Position &, const MoveGoal &, Action &a)
+      {
+        // cut off by walls, the straight move set with the goal stays
+        if (agents[i].reachable)
+          a.action = agents[i].move;
+        i++;
+        entity.remove<MoveGoal>();
+      });
+    });
+  });
+}
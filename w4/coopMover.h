@@ -0,0 +1,5 @@
+#pragma once
+#include <flecs.h>
+
+// plans moves of everyone with a MoveGoal in one batch and takes the goals away
+void process_coop_movers(flecs::world &ecs);
@@ -0,0 +1,266 @@
+#include "cooperativePlanner.h"
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+static int get_move(size_t from, size_t to, size_t width)
+{
+  if (to == from + 1)
+    return EA_MOVE_RIGHT;
+  if (to + 1 == from)
+    return EA_MOVE_LEFT;
+  if (to == from + width)
+    return EA_MOVE_DOWN;
+  if (to + width == from)
+    return EA_MOVE_UP;
+  return EA_NOP;
+}
+
+template<typename Callable>
+static void for_each_move(const DungeonData &dd, uint32_t tile, Callable c)
+{
+  const int x = int(tile % dd.width);
+  const int y = int(tile / dd.width);
+  // waiting is a move too
+  c(tile);
+  if (dd.walkGrid.is_walkable(x - 1, y))
+    c(tile - 1);
+  if (dd.walkGrid.is_walkable(x + 1, y))
+    c(tile + 1);
+  if (dd.walkGrid.is_walkable(x, y - 1))
+    c(uint32_t(tile - dd.width));
+  if (dd.walkGrid.is_walkable(x, y + 1))
+    c(uint32_t(tile + dd.width));
+}
+
+void CooperativePlanner::plan(const DungeonData &dd, const OccupancyGrid &occupancy, std::span<CoopAgent> agents)
+{
+  stats = Stats{};
+  stats.numAgents = agents.size();
+  numGoals = 0;
+  const std::vector<uint32_t> &occupied = occupancy.get_occupied_tiles();
+  reservations.clear((agents.size() + occupied.size()) * (window + 1));
+
+  auto get_tile = [&](Position pos)
+  {
+    if (pos.x < 0 || pos.y < 0 || pos.x >= int(dd.width) || pos.y >= int(dd.height))
+      return unreachable;
+    return uint32_t(size_t(pos.y) * dd.width + size_t(pos.x));
+  };
+  // Agents keep their tiles for the first move. process_actions checks moves against move positions
+  // in no particular order, so a tile which is left this turn can't be entered this turn.
+  for (uint32_t i = 0; i < agents.size(); ++i)
+  {
+    const uint32_t tile = get_tile(agents[i].pos);
+    if (tile == unreachable)
+      continue;
+    reservations.insert(tile, 0, i);
+    reservations.insert(tile, 1, i);
+  }
+  for (uint32_t tile : occupied)
+    if (!reservations.find(tile, 0))
+      for (uint32_t turn = 0; turn <= window; ++turn)
+        reservations.insert(tile, turn, obstacle_id);
+
+  // Only creatures which have stood on their tiles since the last plan are expensive in the trees.
+  // Ones which walk on are gone by the time an agent gets there, and every step of theirs would
+  // need a repair in every tree.
+  wasOccupied.resize(dd.width * dd.height, 0);
+  occupiedPositions.clear();
+  for (uint32_t tile : occupied)
+    if (wasOccupied[tile])
+      occupiedPositions.push_back(Position{int(tile % dd.width), int(tile / dd.width)});
+  for (uint32_t tile : lastOccupied)
+    wasOccupied[tile] = 0;
+  lastOccupied = occupied;
+  for (uint32_t tile : lastOccupied)
+    wasOccupied[tile] = 1;
+
+  agentGoals.resize(agents.size());
+  agentDists.resize(agents.size());
+  for (size_t i = 0; i < agents.size(); ++i)
+  {
+    const uint32_t goalTile = get_tile(agents[i].goal);
+    agentGoals[i] = goalTile != unreachable ? uint32_t(get_goal_slot(dd, goalTile)) : unreachable;
+    if (agentGoals[i] != unreachable)
+      goals[agentGoals[i]].numAgents++;
+  }
+  for (size_t i = 0; i < numGoals; ++i)
+    goals[i].tree.set_focused(goals[i].numAgents == 1);
+  for (size_t i = 0; i < agents.size(); ++i)
+  {
+    const uint32_t startTile = get_tile(agents[i].pos);
+    agentDists[i] = unreachable;
+    if (startTile != unreachable && agentGoals[i] != unreachable)
+    {
+      DStarLite &tree = goals[agentGoals[i]].tree;
+      tree.set_start(agents[i].pos);
+      tree.compute_path();
+      stats.numTreeExpanded += tree.numExpanded;
+      if (tree.get_start_distance() < DStarLite::blocked)
+        agentDists[i] = uint32_t(tree.get_start_distance());
+    }
+    agents[i].reachable = agentDists[i] != unreachable;
+    agents[i].move = EA_NOP;
+  }
+  stats.numGoals = numGoals;
+
+  // the ones in front go first, so the ones behind queue up instead of blocking them
+  order.resize(agents.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](uint32_t lhs, uint32_t rhs) { return agentDists[lhs] < agentDists[rhs]; });
+
+  for (uint32_t i : order)
+  {
+    CoopAgent &agent = agents[i];
+    const uint32_t startTile = get_tile(agent.pos);
+    if (startTile == unreachable)
+      continue;
+    if (!agent.reachable)
+    {
+      for (uint32_t turn = 0; turn <= window; ++turn)
+        reservations.insert(startTile, turn, i);
+      continue;
+    }
+    plan_agent(dd, agent, i, occupancy.is_occupied(agent.goal.x, agent.goal.y), goals[agentGoals[i]].tree);
+  }
+  stats.numReserved = reservations.size();
+}
+
+size_t CooperativePlanner::get_allocated_bytes() const
+{
+  size_t res = reservations.get_allocated_bytes() + nodes.get_allocated_bytes();
+  res += open.capacity() * sizeof(OpenNode) + goals.capacity() * sizeof(GoalTree);
+  for (const GoalTree &gt : goals)
+    res += gt.tree.get_allocated_bytes();
+  res += (occupiedPositions.capacity() + goalOccupied.capacity()) * sizeof(Position);
+  res += (lastOccupied.capacity() + order.capacity() + agentGoals.capacity() + agentDists.capacity() +
+          pathTiles.capacity()) * sizeof(uint32_t) + wasOccupied.capacity();
+  return res;
+}
+
+size_t CooperativePlanner::get_goal_slot(const DungeonData &dd, uint32_t goal_idx)
+{
+  for (size_t i = 0; i < numGoals; ++i)
+    if (goals[i].goalIdx == goal_idx)
+      return i;
+  // a tree of the same goal from the last plans is repaired rather than started again
+  size_t slot = numGoals;
+  for (size_t i = numGoals; i < goals.size(); ++i)
+    if (goals[i].goalIdx == goal_idx)
+      slot = i;
+  if (slot == goals.size())
+    goals.emplace_back();
+  std::swap(goals[numGoals], goals[slot]);
+  GoalTree &gt = goals[numGoals];
+  gt.goalIdx = goal_idx;
+  gt.numAgents = 0;
+  gt.tree.set_goal(dd, Position{int(goal_idx % dd.width), int(goal_idx / dd.width)});
+  // the goal is the one creature an agent can go into, its attacker shouldn't avoid it
+  goalOccupied.clear();
+  for (const Position &pos : occupiedPositions)
+    if (size_t(pos.y) * dd.width + size_t(pos.x) != goal_idx)
+      goalOccupied.push_back(pos);
+  gt.tree.set_occupied_tiles(goalOccupied);
+  return numGoals++;
+}
+
+bool CooperativePlanner::is_free(uint32_t tile, uint32_t turn, uint32_t agent_id) const
+{
+  const uint32_t *owner = reservations.find(tile, turn);
+  return !owner || *owner == agent_id;
+}
+
+void CooperativePlanner::plan_agent(const DungeonData &dd, CoopAgent &agent, uint32_t agent_id, bool attack,
+                                    DStarLite &tree)
+{
+  const uint32_t startTile = uint32_t(size_t(agent.pos.y) * dd.width + size_t(agent.pos.x));
+  const uint32_t goalTile = uint32_t(size_t(agent.goal.y) * dd.width + size_t(agent.goal.x));
+  // agents of the same goal have moved the start of the tree since
+  tree.set_start(agent.pos);
+  tree.compute_path();
+  stats.numTreeExpanded += tree.numExpanded;
+  auto get_h = [&](uint32_t tile)
+  {
+    const float known = tree.get_known_distance(tile);
+    if (known < DStarLite::blocked)
+      return uint32_t(known);
+    // every move costs at least 1
+    return uint32_t(abs(int(tile % dd.width) - agent.goal.x) + abs(int(tile / dd.width) - agent.goal.y));
+  };
+  // open nodes at most 5 per expansion, closed ones are fewer than tiles around times turns
+  nodes.clear(size_t(window + 1) * 64);
+  open.clear();
+  auto lower_priority = [](const OpenNode &lhs, const OpenNode &rhs)
+  {
+    // ties go to the deeper node, it's closer to the goal
+    return lhs.f > rhs.f || (lhs.f == rhs.f && lhs.g < rhs.g);
+  };
+  nodes.insert(startTile, 0, SearchNode{0, startTile, false});
+  open.push_back(OpenNode{get_h(startTile), 0, startTile, 0});
+  uint32_t lastTile = unreachable;
+  uint32_t lastTurn = 0;
+  while (!open.empty())
+  {
+    std::pop_heap(open.begin(), open.end(), lower_priority);
+    const OpenNode cur = open.back();
+    open.pop_back();
+    SearchNode &node = nodes.at(cur.tile, cur.turn);
+    if (node.closed)
+      continue;
+    node.closed = true;
+    stats.numExpanded++;
+    if (cur.tile == goalTile || cur.turn == window)
+    {
+      lastTile = cur.tile;
+      lastTurn = cur.turn;
+      break;
+    }
+    const uint32_t nextTurn = cur.turn + 1;
+    for_each_move(dd, cur.tile, [&](uint32_t next)
+    {
+      // moving into a creature which is the goal is an attack, it's always possible
+      if (!(attack && next == goalTile))
+      {
+        if (!is_free(next, nextTurn, agent_id))
+          return;
+        // nobody comes the other way, process_actions can't swap two creatures either
+        const uint32_t *there = reservations.find(next, cur.turn);
+        const uint32_t *here = reservations.find(cur.tile, nextTurn);
+        if (next != cur.tile && there && here && *there == *here && *there != agent_id)
+          return;
+      }
+      const uint32_t g = cur.g + 1;
+      SearchNode &nextNode = nodes.insert(next, nextTurn, SearchNode{unreachable, cur.tile, false});
+      if (nextNode.closed || g >= nextNode.g)
+        return;
+      nextNode.g = g;
+      nextNode.parentTile = cur.tile;
+      open.push_back(OpenNode{g + get_h(next), g, next, nextTurn});
+      std::push_heap(open.begin(), open.end(), lower_priority);
+    });
+  }
+
+  if (lastTile == unreachable)
+  {
+    // boxed in for the whole window, it waits
+    for (uint32_t turn = 0; turn <= window; ++turn)
+      reservations.insert(startTile, turn, agent_id);
+    return;
+  }
+  pathTiles.resize(lastTurn + 1);
+  for (uint32_t turn = lastTurn, tile = lastTile; turn > 0; --turn)
+  {
+    pathTiles[turn] = tile;
+    tile = nodes.at(tile, turn).parentTile;
+  }
+  pathTiles[0] = startTile;
+  if (lastTurn > 0)
+    agent.move = get_move(startTile, pathTiles[1], dd.width);
+  // an attacker stays in front of the goal
+  if (attack && lastTile == goalTile && lastTurn > 0)
+    pathTiles[lastTurn] = pathTiles[lastTurn - 1];
+  for (uint32_t turn = 0; turn <= window; ++turn)
+    reservations.insert(pathTiles[std::min(turn, lastTurn)], turn, agent_id);
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "ecsTypes.h"
+#include "dStarLite.h"
+
+// Open addressing hash of (tile, turn) keys, only what's reserved or visited takes memory,
+// not tiles times turns. clear is O(1), slots of older generations count as empty.
+template<typename T>
+class SpaceTimeTable
+{
+public:
+  // forgets everything, has room for at least `count` entries before it grows
+  void clear(size_t count)
+  {
+    size_t capacity = slots.empty() ? 64 : slots.size();
+    while (capacity < count * 2)
+      capacity *= 2;
+    if (capacity != slots.size() || ++generation == 0)
+    {
+      slots.assign(capacity, Slot{});
+      generation = 1;
+    }
+    numEntries = 0;
+  }
+
+  T *find(uint32_t tile, uint32_t turn)
+  {
+    const uint64_t key = make_key(tile, turn);
+    for (size_t i = hash(key);; i = (i + 1) & (slots.size() - 1))
+    {
+      Slot &slot = slots[i];
+      if (slot.generation != generation)
+        return nullptr;
+      if (slot.key == key)
+        return &slot.value;
+    }
+  }
+  const T *find(uint32_t tile, uint32_t turn) const { return const_cast<SpaceTimeTable *>(this)->find(tile, turn); }
+  // the entry which is known to be there, a default one is added if it isn't
+  T &at(uint32_t tile, uint32_t turn) { return insert(tile, turn, T{}); }
+
+  // the entry if it's there already, otherwise a new one with this value
+  T &insert(uint32_t tile, uint32_t turn, const T &value)
+  {
+    if ((numEntries + 1) * 2 > slots.size())
+      grow();
+    const uint64_t key = make_key(tile, turn);
+    size_t i = hash(key);
+    for (; slots[i].generation == generation; i = (i + 1) & (slots.size() - 1))
+      if (slots[i].key == key)
+        return slots[i].value;
+    slots[i] = Slot{key, generation, value};
+    numEntries++;
+    return slots[i].value;
+  }
+
+  size_t size() const { return numEntries; }
+  size_t get_allocated_bytes() const { return slots.capacity() * sizeof(Slot); }
+
+private:
+  struct Slot
+  {
+    uint64_t key = 0;
+    uint32_t generation = 0;
+    T value{};
+  };
+
+  static uint64_t make_key(uint32_t tile, uint32_t turn) { return uint64_t(turn) << 32 | tile; }
+  size_t hash(uint64_t key) const
+  {
+    // fibonacci hashing, the top bits are the best mixed ones
+    return size_t((key * 0x9e3779b97f4a7c15ull) >> (64 - std::countr_zero(slots.size())));
+  }
+
+  void grow()
+  {
+    std::vector<Slot> old;
+    old.swap(slots);
+    slots.assign(std::max(old.size() * 2, size_t(64)), Slot{});
+    const uint32_t oldGeneration = generation;
+    generation = 1;
+    numEntries = 0;
+    for (const Slot &slot : old)
+      if (slot.generation == oldGeneration)
+        insert(uint32_t(slot.key), uint32_t(slot.key >> 32), slot.value);
+  }
+
+  std::vector<Slot> slots;
+  uint32_t generation = 0;
+  size_t numEntries = 0;
+};
+
+struct CoopAgent
+{
+  Position pos;
+  // another creature to attack or a free tile to stand on
+  Position goal;
+  // results
+  int move = EA_NOP;
+  bool reachable = false; // false if walls cut the goal off, move is a wait then
+};
+
+// Windowed hierarchical cooperative A* (WHCA*): a batch of agents is planned together once
+// per turn. Agents go one after another, closest to their goals first, every plan is a search
+// in space and time which reserves its tiles for the next `window` turns in a shared table,
+// so later agents go around or wait instead of walking into each other.
+// Beyond the window the heuristic is the distance to the goal from a D* Lite tree, one per
+// distinct goal, most monsters chase the same player so it's shared. Creatures which stand still
+// are expensive tiles there, so agents head for corridors which aren't blocked further away.
+// Trees are kept between plans: for a goal which stays (a hive, a patrol point) only what creatures
+// made inconsistent is repaired, a goal which moved starts its tree again. A tree of one agent is
+// focused on it, a shared one grows evenly from the goal. Tiles the tree hasn't made exact yet
+// get the manhattan distance.
+// Only the first move of a plan is made, the next turn everyone is planned again.
+class CooperativePlanner
+{
+public:
+  explicit CooperativePlanner(uint32_t window_turns = 8) : window(window_turns) {}
+
+  // Creatures on the occupancy grid which aren't in the batch are obstacles for every turn
+  // of the window, moving into one of them is only allowed for an agent whose goal it is.
+  void plan(const DungeonData &dd, const OccupancyGrid &occupancy, std::span<CoopAgent> agents);
+
+  struct Stats
+  {
+    size_t numAgents = 0;
+    size_t numExpanded = 0;
+    size_t numTreeExpanded = 0; // by D* Lite
+    size_t numReserved = 0;
+    size_t numGoals = 0;
+  };
+  // of the last plan
+  const Stats &get_stats() const { return stats; }
+  size_t get_allocated_bytes() const;
+
+  uint32_t window;
+
+private:
+  static constexpr uint32_t obstacle_id = 0xffffffff;
+  static constexpr uint32_t unreachable = 0xffffffff;
+
+  struct GoalTree
+  {
+    uint32_t goalIdx = unreachable;
+    uint32_t numAgents = 0; // in this plan
+    DStarLite tree;
+  };
+
+  struct SearchNode
+  {
+    uint32_t g;
+    uint32_t parentTile;
+    bool closed;
+  };
+
+  struct OpenNode
+  {
+    uint32_t f;
+    uint32_t g;
+    uint32_t tile;
+    uint32_t turn;
+  };
+
+  // slot in goals, the tree of the goal is taken from the last plans or started
+  // and gets the occupied tiles on the first request of the plan
+  size_t get_goal_slot(const DungeonData &dd, uint32_t goal_idx);
+  void plan_agent(const DungeonData &dd, CoopAgent &agent, uint32_t agent_id, bool attack, DStarLite &tree);
+  bool is_free(uint32_t tile, uint32_t turn, uint32_t agent_id) const;
+
+  SpaceTimeTable<uint32_t> reservations; // agent which stands on a tile at a turn
+  SpaceTimeTable<SearchNode> nodes;
+  std::vector<OpenNode> open;
+  std::vector<GoalTree> goals; // the ones of this plan first, then the rest kept from the last ones
+  size_t numGoals = 0;
+  std::vector<Position> occupiedPositions; // the ones which stood still since the last plan
+  std::vector<Position> goalOccupied;
+  std::vector<uint32_t> lastOccupied;
+  std::vector<uint8_t> wasOccupied; // by tile, the ones of lastOccupied
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> agentGoals; // goal slot of every agent
+  std::vector<uint32_t> agentDists;
+  std::vector<uint32_t> pathTiles;
+  Stats stats;
+};
@@ -0,0 +1,306 @@
+#include "dStarLite.h"
+#include <algorithm>
+#include <cstdlib>
+
+void DStarLite::set_goal(const DungeonData &dd, Position goal)
+{
+  const bool inBounds = goal.x >= 0 && goal.y >= 0 && goal.x < int(dd.width) && goal.y < int(dd.height);
+  const uint32_t newGoalIdx = inBounds ? uint32_t(size_t(goal.y) * dd.width + size_t(goal.x)) : invalid_idx;
+  if (width == dd.width && height == dd.height && goalIdx == newGoalIdx && !tiles.empty())
+    return;
+
+  width = dd.width;
+  height = dd.height;
+  goalIdx = newGoalIdx;
+  startIdx = invalid_idx;
+  lastIdx = invalid_idx;
+  keyOffset = 0.f;
+  baseCost.resize(width * height);
+  for (size_t i = 0; i < baseCost.size(); ++i)
+    baseCost[i] = dd.walkGrid.is_walkable(int(i % width), int(i / width)) ? 1.f : blocked;
+  cost = baseCost;
+  occupied.clear();
+  isOccupied.assign(width * height, 0);
+  tiles.assign(width * height, TileState{});
+  heap.clear();
+  if (goalIdx == invalid_idx)
+    return;
+  tiles[goalIdx].rhs = 0.f;
+  heap_push(goalIdx, Key{0.f, 0.f});
+}
+
+void DStarLite::set_start(Position start)
+{
+  if (start.x < 0 || start.y < 0 || start.x >= int(width) || start.y >= int(height))
+  {
+    startIdx = invalid_idx;
+    return;
+  }
+  startIdx = uint32_t(size_t(start.y) * width + size_t(start.x));
+  if (lastIdx == invalid_idx)
+    lastIdx = startIdx;
+  // keys in the queue were computed from the old start, every one of them is
+  // overestimated by at most this much, so they are just shifted instead of recomputed
+  keyOffset += heuristic(lastIdx);
+  lastIdx = startIdx;
+  // a start which jumps around, like when agents share a tree, grows the offset quickly,
+  // keys are computed again before floats lose the precision to order them
+  if (keyOffset > max_key_offset)
+    recompute_keys();
+}
+
+void DStarLite::set_focused(bool is_focused)
+{
+  if (focused == is_focused)
+    return;
+  focused = is_focused;
+  recompute_keys();
+}
+
+void DStarLite::recompute_keys()
+{
+  keyOffset = 0.f;
+  for (HeapNode &node : heap)
+    node.key = calculate_key(node.idx);
+  for (size_t pos = heap.size() / 2; pos-- > 0;)
+    sift_down(pos);
+}
+
+void DStarLite::set_tile_cost(Position pos, float c)
+{
+  if (pos.x < 0 || pos.y < 0 || pos.x >= int(width) || pos.y >= int(height))
+    return;
+  const uint32_t idx = uint32_t(size_t(pos.y) * width + size_t(pos.x));
+  if (baseCost[idx] == blocked || cost[idx] == c)
+    return;
+  cost[idx] = c;
+  // moves into the tile have changed, so did the distances of tiles next to it
+  for_each_neighbour(idx, [&](uint32_t nidx) { update_tile(nidx); });
+}
+
+void DStarLite::set_occupied_tiles(const std::vector<Position> &occupied_tiles)
+{
+  prevOccupied.swap(occupied);
+  occupied.clear();
+  for (uint32_t idx : prevOccupied)
+    isOccupied[idx] = 0;
+  for (const Position &pos : occupied_tiles)
+  {
+    if (pos.x < 0 || pos.y < 0 || pos.x >= int(width) || pos.y >= int(height))
+      continue;
+    const uint32_t idx = uint32_t(size_t(pos.y) * width + size_t(pos.x));
+    set_tile_cost(pos, std::max(baseCost[idx], occupied_cost));
+    occupied.push_back(idx);
+    isOccupied[idx] = 1;
+  }
+  for (uint32_t idx : prevOccupied)
+    if (!isOccupied[idx])
+      set_tile_cost(Position{int(idx % width), int(idx / width)}, baseCost[idx]);
+}
+
+void DStarLite::compute_path()
+{
+  numExpanded = 0;
+  if (startIdx == invalid_idx || goalIdx == invalid_idx)
+    return;
+  while (!heap.empty() &&
+         (heap.front().key < calculate_key(startIdx) || tiles[startIdx].rhs > tiles[startIdx].g))
+  {
+    const uint32_t idx = heap.front().idx;
+    const Key oldKey = heap.front().key;
+    const Key newKey = calculate_key(idx);
+    numExpanded++;
+    TileState &ts = tiles[idx];
+    if (oldKey < newKey)
+      heap_update(idx, newKey);
+    else if (ts.g > ts.rhs)
+    {
+      // overconsistent, distance went down
+      ts.g = ts.rhs;
+      heap_remove(idx);
+      for_each_neighbour(idx, [&](uint32_t nidx) { update_tile(nidx); });
+    }
+    else
+    {
+      // underconsistent, distance went up, the tile and everything routed through it is recomputed
+      ts.g = blocked;
+      update_tile(idx);
+      for_each_neighbour(idx, [&](uint32_t nidx) { update_tile(nidx); });
+    }
+  }
+}
+
+std::vector<Position> DStarLite::get_path() const
+{
+  std::vector<Position> res;
+  if (startIdx == invalid_idx || goalIdx == invalid_idx || tiles[startIdx].rhs >= blocked)
+    return res;
+  uint32_t cur = startIdx;
+  res.push_back(Position{int(cur % width), int(cur / width)});
+  while (cur != goalIdx && res.size() <= tiles.size())
+  {
+    uint32_t next = invalid_idx;
+    float best = blocked;
+    for_each_neighbour(cur, [&](uint32_t nidx)
+    {
+      const float dist = cost[nidx] + tiles[nidx].g;
+      if (dist < best)
+      {
+        best = dist;
+        next = nidx;
+      }
+    });
+    if (next == invalid_idx)
+      return std::vector<Position>();
+    cur = next;
+    res.push_back(Position{int(cur % width), int(cur / width)});
+  }
+  return res;
+}
+
+float DStarLite::get_start_distance() const
+{
+  if (startIdx == invalid_idx || goalIdx == invalid_idx)
+    return blocked;
+  return tiles[startIdx].rhs;
+}
+
+float DStarLite::get_known_distance(uint32_t idx) const
+{
+  const TileState &ts = tiles[idx];
+  if (ts.heapIdx != invalid_idx || ts.g != ts.rhs || ts.g >= blocked)
+    return blocked;
+  // a tile ahead of the queue could depend on costs which have changed since it was expanded
+  if (!heap.empty() && heap.front().key < calculate_key(idx))
+    return blocked;
+  return ts.g;
+}
+
+size_t DStarLite::get_allocated_bytes() const
+{
+  return (baseCost.capacity() + cost.capacity()) * sizeof(float) + tiles.capacity() * sizeof(TileState) +
+         heap.capacity() * sizeof(HeapNode) + (occupied.capacity() + prevOccupied.capacity()) * sizeof(uint32_t) +
+         isOccupied.capacity();
+}
+
+DStarLite::Key DStarLite::calculate_key(uint32_t idx) const
+{
+  const TileState &ts = tiles[idx];
+  const float dist = std::min(ts.g, ts.rhs);
+  return Key{std::min(dist + heuristic(idx) + keyOffset, blocked), dist};
+}
+
+// manhattan distance to the start, 4-connected moves cost at least 1
+float DStarLite::heuristic(uint32_t idx) const
+{
+  if (!focused)
+    return 0.f;
+  const int dx = int(idx % width) - int(startIdx % width);
+  const int dy = int(idx / width) - int(startIdx / width);
+  return float(abs(dx) + abs(dy));
+}
+
+void DStarLite::update_tile(uint32_t idx)
+{
+  TileState &ts = tiles[idx];
+  if (idx != goalIdx)
+  {
+    float rhs = blocked;
+    for_each_neighbour(idx, [&](uint32_t nidx) { rhs = std::min(rhs, cost[nidx] + tiles[nidx].g); });
+    ts.rhs = std::min(rhs, blocked);
+  }
+  if (ts.heapIdx != invalid_idx)
+  {
+    if (ts.g != ts.rhs)
+      heap_update(idx, calculate_key(idx));
+    else
+      heap_remove(idx);
+  }
+  else if (ts.g != ts.rhs)
+    heap_push(idx, calculate_key(idx));
+}
+
+// walls are never entered and never left, they aren't part of the graph
+template<typename Callable>
+void DStarLite::for_each_neighbour(uint32_t idx, Callable c) const
+{
+  const size_t x = idx % width;
+  const size_t y = idx / width;
+  if (x > 0 && baseCost[idx - 1] < blocked)
+    c(uint32_t(idx - 1));
+  if (x + 1 < width && baseCost[idx + 1] < blocked)
+    c(uint32_t(idx + 1));
+  if (y > 0 && baseCost[idx - width] < blocked)
+    c(uint32_t(idx - width));
+  if (y + 1 < height && baseCost[idx + width] < blocked)
+    c(uint32_t(idx + width));
+}
+
+void DStarLite::heap_push(uint32_t idx, Key key)
+{
+  tiles[idx].heapIdx = uint32_t(heap.size());
+  heap.push_back({key, idx});
+  sift_up(heap.size() - 1);
+}
+
+void DStarLite::heap_remove(uint32_t idx)
+{
+  const size_t pos = tiles[idx].heapIdx;
+  tiles[idx].heapIdx = invalid_idx;
+  if (pos + 1 == heap.size())
+  {
+    heap.pop_back();
+    return;
+  }
+  const uint32_t moved = heap.back().idx;
+  heap[pos] = heap.back();
+  heap.pop_back();
+  tiles[moved].heapIdx = uint32_t(pos);
+  sift_up(pos);
+  sift_down(tiles[moved].heapIdx);
+}
+
+void DStarLite::heap_update(uint32_t idx, Key key)
+{
+  const size_t pos = tiles[idx].heapIdx;
+  heap[pos].key = key;
+  sift_up(pos);
+  sift_down(tiles[idx].heapIdx);
+}
+
+void DStarLite::sift_up(size_t pos)
+{
+  const HeapNode node = heap[pos];
+  while (pos > 0)
+  {
+    const size_t parent = (pos - 1) / 2;
+    if (!(node.key < heap[parent].key))
+      break;
+    heap[pos] = heap[parent];
+    tiles[heap[pos].idx].heapIdx = uint32_t(pos);
+    pos = parent;
+  }
+  heap[pos] = node;
+  tiles[node.idx].heapIdx = uint32_t(pos);
+}
+
+void DStarLite::sift_down(size_t pos)
+{
+  const HeapNode node = heap[pos];
+  const size_t count = heap.size();
+  while (true)
+  {
+    size_t child = pos * 2 + 1;
+    if (child >= count)
+      break;
+    if (child + 1 < count && heap[child + 1].key < heap[child].key)
+      child++;
+    if (!(heap[child].key < node.key))
+      break;
+    heap[pos] = heap[child];
+    tiles[heap[pos].idx].heapIdx = uint32_t(pos);
+    pos = child;
+  }
+  heap[pos] = node;
+  tiles[node.idx].heapIdx = uint32_t(pos);
+}
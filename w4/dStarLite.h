@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ecsTypes.h"
+
+// D* Lite: searches backwards from the goal, so the tree stays valid while the agent walks,
+// only the key offset grows. When tile costs change (other creatures standing in corridors)
+// only tiles whose distance becomes inconsistent are expanded again.
+// Walls are copied from DungeonData when the goal is set for the first time or moved.
+class DStarLite
+{
+public:
+  static constexpr float blocked = 1e30f;
+  static constexpr float occupied_cost = OccupancyGrid::occupied_cost;
+
+  // keeps the search tree if the goal and the map are the same
+  void set_goal(const DungeonData &dd, Position goal);
+  // keys depend on the start, set it before changing costs
+  void set_start(Position start);
+  // A tree shared by agents all around the goal is better off growing evenly from the goal,
+  // like a dijkstra map, than towards the start of each of them in turn. Moving the start costs
+  // nothing then. On by default.
+  void set_focused(bool is_focused);
+  // cost of entering the tile
+  void set_tile_cost(Position pos, float cost);
+  // tiles of the previous call get their cost back
+  void set_occupied_tiles(const std::vector<Position> &tiles);
+
+  void compute_path();
+  // from the start to the goal, empty if the goal is unreachable
+  std::vector<Position> get_path() const;
+
+  // distance from the start to the goal after compute_path, blocked if the goal is unreachable
+  float get_start_distance() const;
+  // distance from the tile to the goal if compute_path has made it exact, that's every consistent
+  // tile with a key below the queue, blocked for the rest
+  float get_known_distance(uint32_t idx) const;
+
+  size_t get_allocated_bytes() const;
+
+  // stats of the last compute_path
+  size_t numExpanded = 0;
+
+private:
+  struct Key
+  {
+    float primary;
+    float secondary;
+    bool operator<(const Key &rhs) const
+    {
+      return primary < rhs.primary || (primary == rhs.primary && secondary < rhs.secondary);
+    }
+  };
+
+  struct TileState
+  {
+    float g = blocked;
+    float rhs = blocked;
+    uint32_t heapIdx = invalid_idx;
+  };
+
+  struct HeapNode
+  {
+    Key key;
+    uint32_t idx;
+  };
+
+  static constexpr uint32_t invalid_idx = 0xffffffff;
+  static constexpr float max_key_offset = 65536.f;
+
+  Key calculate_key(uint32_t idx) const;
+  void recompute_keys();
+  float heuristic(uint32_t idx) const;
+  void update_tile(uint32_t idx);
+
+  template<typename Callable>
+  void for_each_neighbour(uint32_t idx, Callable c) const;
+
+  void heap_push(uint32_t idx, Key key);
+  void heap_remove(uint32_t idx);
+  void heap_update(uint32_t idx, Key key);
+  void sift_up(size_t pos);
+  void sift_down(size_t pos);
+
+  size_t width = 0;
+  size_t height = 0;
+  uint32_t startIdx = invalid_idx;
+  uint32_t goalIdx = invalid_idx;
+  // start of the last compute_path, keys are offset by how far the start has moved since
+  uint32_t lastIdx = invalid_idx;
+  float keyOffset = 0.f;
+  bool focused = true;
+  std::vector<float> baseCost;
+  std::vector<float> cost;
+  std::vector<TileState> tiles;
+  std::vector<HeapNode> heap;
+  std::vector<uint32_t> occupied;
+  std::vector<uint32_t> prevOccupied;
+  std::vector<uint8_t> isOccupied; // by tile, the tiles of occupied
+};
@@ -1,11 +1,12 @@
 #include "dijkstraMapGen.h"
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
+#include "dmapQueue.h"
 
 template<typename Callable>
 static void query_dungeon_data(flecs::world &ecs, Callable c)
 {
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  static auto dungeonDataQuery = ecs.query<const DungeonData, const OccupancyGrid>();
 
   dungeonDataQuery.each(c);
 }
@@ -18,91 +19,115 @@ static void query_characters_positions(flecs::world &ecs, Callable c)
   characterPositionQuery.each(c);
 }
 
-constexpr float invalid_tile_value = 1e5f;
+static void get_player_sources(flecs::world &ecs, const DungeonData &dd, std::vector<uint32_t> &sources)
+{
+  sources.clear();
+  query_characters_positions(ecs, [&](const Position &pos, const Team &t)
+  {
+    if (t.team == 0) // player team hardcode
+      sources.push_back(uint32_t(size_t(pos.y) * dd.width + size_t(pos.x)));
+  });
+}
 
-static void init_tiles(std::vector<float> &map, const DungeonData &dd)
+static void get_hive_sources(flecs::world &ecs, const DungeonData &dd, std::vector<uint32_t> &sources)
 {
-  map.resize(dd.width * dd.height);
+  static auto hiveQuery = ecs.query<const Position, const Hive>();
+  sources.clear();
+  hiveQuery.each([&](const Position &pos, const Hive &)
+  {
+    sources.push_back(uint32_t(size_t(pos.y) * dd.width + size_t(pos.x)));
+  });
+}
+
+static DmapQueue dmapQueue;
+// flee values are the approach ones scaled past 0, so a fleeing creature prefers
+// a longer way round the player to a dead end
+static constexpr float flee_multiplier = -1.2f;
+
+void dmaps::gen_sources_map(const DungeonData &dd, const OccupancyGrid &occupancy,
+                            const std::vector<uint32_t> &sources, std::vector<float> &map)
+{
+  map.assign(dd.width * dd.height, invalid_tile_value);
+  for (uint32_t idx : sources)
+    map[idx] = 0.f;
+  dmapQueue.process_sources(map, dd, occupancy, sources);
+}
+
+void dmaps::gen_flee_map(const DungeonData &dd, const OccupancyGrid &occupancy,
+                         const std::vector<float> &approach_map, std::vector<float> &map)
+{
+  map = approach_map;
   for (float &v : map)
-    v = invalid_tile_value;
+    if (v < invalid_tile_value)
+      v *= flee_multiplier;
+  dmapQueue.relax(map, dd, occupancy);
 }
 
-// scan version, could be implemented as Dijkstra version as well
-static void process_dmap(std::vector<float> &map, const DungeonData &dd)
+void dmaps::update_sources_map(const DungeonData &dd, const OccupancyGrid &occupancy,
+                               const std::vector<uint32_t> &sources, std::vector<float> &map, IncrementalDmap &dmap)
 {
-  bool done = false;
-  auto getMapAt = [&](size_t x, size_t y, float def)
-  {
-    if (x < dd.width && y < dd.width && dd.tiles[y * dd.width + x] == dungeon::floor)
-      return map[y * dd.width + x];
-    return def;
-  };
-  auto getMinNei = [&](size_t x, size_t y)
-  {
-    float val = map[y * dd.width + x];
-    val = std::min(val, getMapAt(x - 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 0, y - 1, val));
-    val = std::min(val, getMapAt(x + 0, y + 1, val));
-    return val;
-  };
-  while (!done)
-  {
-    done = true;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-      {
-        const size_t i = y * dd.width + x;
-        if (dd.tiles[i] != dungeon::floor)
-          continue;
-        const float myVal = getMapAt(x, y, invalid_tile_value);
-        const float minVal = getMinNei(x, y);
-        if (minVal < myVal - 1.f)
-        {
-          map[i] = minVal + 1.f;
-          done = false;
-        }
-      }
-  }
+  dmap.set_sources(sources);
+  dmap.update(dd, occupancy, map);
+}
+
+void dmaps::update_flee_map(const DungeonData &dd, const OccupancyGrid &occupancy,
+                            const std::vector<float> &approach_map, const IncrementalDmap &approach_dmap,
+                            std::vector<float> &map, IncrementalDmap &dmap)
+{
+  // every approach tile is a seed of the flee map, only the changed ones are set again
+  for (uint32_t idx : approach_dmap.get_changed_tiles())
+    dmap.set_seed(idx, approach_map[idx] < invalid_tile_value ? approach_map[idx] * flee_multiplier : invalid_tile_value);
+  dmap.update(dd, occupancy, map);
 }
 
 void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map)
 {
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
+  static std::vector<uint32_t> sources;
+  query_dungeon_data(ecs, [&](const DungeonData &dd, const OccupancyGrid &occupancy)
   {
-    init_tiles(map, dd);
-    query_characters_positions(ecs, [&](const Position &pos, const Team &t)
-    {
-      if (t.team == 0) // player team hardcode
-        map[pos.y * dd.width + pos.x] = 0.f;
-    });
-    process_dmap(map, dd);
+    get_player_sources(ecs, dd, sources);
+    gen_sources_map(dd, occupancy, sources, map);
   });
 }
 
 void dmaps::gen_player_flee_map(flecs::world &ecs, std::vector<float> &map)
 {
-  gen_player_approach_map(ecs, map);
-  for (float &v : map)
-    if (v < invalid_tile_value)
-      v *= -1.2f;
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
+  static std::vector<float> approachMap;
+  gen_player_approach_map(ecs, approachMap);
+  query_dungeon_data(ecs, [&](const DungeonData &dd, const OccupancyGrid &occupancy)
   {
-    process_dmap(map, dd);
+    gen_flee_map(dd, occupancy, approachMap, map);
   });
 }
 
 void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map)
 {
-  static auto hiveQuery = ecs.query<const Position, const Hive>();
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
+  static std::vector<uint32_t> sources;
+  query_dungeon_data(ecs, [&](const DungeonData &dd, const OccupancyGrid &occupancy)
+  {
+    get_hive_sources(ecs, dd, sources);
+    gen_sources_map(dd, occupancy, sources, map);
+  });
+}
+
+void dmaps::update_player_maps(flecs::world &ecs, std::vector<float> &approach_map, IncrementalDmap &approach_dmap,
+                               std::vector<float> &flee_map, IncrementalDmap &flee_dmap)
+{
+  static std::vector<uint32_t> sources;
+  query_dungeon_data(ecs, [&](const DungeonData &dd, const OccupancyGrid &occupancy)
   {
-    init_tiles(map, dd);
-    hiveQuery.each([&](const Position &pos, const Hive &)
-    {
-      map[pos.y * dd.width + pos.x] = 0.f;
-    });
-    process_dmap(map, dd);
+    get_player_sources(ecs, dd, sources);
+    update_sources_map(dd, occupancy, sources, approach_map, approach_dmap);
+    update_flee_map(dd, occupancy, approach_map, approach_dmap, flee_map, flee_dmap);
   });
 }
 
+void dmaps::update_hive_pack_map(flecs::world &ecs, std::vector<float> &map, IncrementalDmap &dmap)
+{
+  static std::vector<uint32_t> sources;
+  query_dungeon_data(ecs, [&](const DungeonData &dd, const OccupancyGrid &occupancy)
+  {
+    get_hive_sources(ecs, dd, sources);
+    update_sources_map(dd, occupancy, sources, map, dmap);
+  });
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ecsTypes.h"
+
+constexpr float invalid_tile_value = 1e5f;
+
+// Dial's algorithm. Tile costs are small integers, 1 or OccupancyGrid::occupied_cost, so values
+// within a bucket of width 1 can't improve each other and buckets are simply taken in order.
+// Only buckets up to the largest cost ahead are ever filled, they're reused as a ring.
+// Tiles are relaxed with the same comparison as the old repeated scans, so maps are the same.
+class DmapQueue
+{
+public:
+  // from sources which are already set in the map, other tiles only get lower
+  // false if it stopped after lowering max_written tiles, the map is half done then
+  bool process_sources(std::vector<float> &map, const DungeonData &dd, const OccupancyGrid &occupancy,
+                       const std::vector<uint32_t> &sources, size_t max_written = SIZE_MAX);
+
+  // every valid tile of the map is a seed, values are arbitrary, like ones of the flee map
+  void relax(std::vector<float> &map, const DungeonData &dd, const OccupancyGrid &occupancy);
+
+  // tiles lowered by the last call, a tile can be there more than once
+  const std::vector<uint32_t> &get_written_tiles() const { return written; }
+
+private:
+  static constexpr size_t ring_size = size_t(OccupancyGrid::occupied_cost) + 2;
+
+  size_t get_bucket(float value) const { return size_t(value - base); }
+
+  // seeds are bucket sorted, they join the queue when their bucket comes
+  void set_seeds(const std::vector<float> &map, const DungeonData &dd, const std::vector<uint32_t> &candidates);
+  bool propagate(std::vector<float> &map, const DungeonData &dd, const OccupancyGrid &occupancy, size_t max_written);
+
+  float base = 0.f;
+  std::vector<uint32_t> ring[ring_size];
+  std::vector<uint32_t> seeds;
+  std::vector<uint32_t> seedOffsets;
+  std::vector<uint32_t> tiles;
+  std::vector<uint32_t> written;
+};
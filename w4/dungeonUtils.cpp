@@ -11,9 +11,9 @@ Position dungeon::find_walkable_tile(flecs::world &ecs)
     // prebuild all walkable and get one of them
     std::vector<Position> posList;
     for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-        if (dd.tiles[y * dd.width + x] == dungeon::floor)
-          posList.push_back(Position{int(x), int(y)});
+      for (size_t x = dd.walkGrid.find_walkable_in_row(y, 0); x < dd.width;
+           x = dd.walkGrid.find_walkable_in_row(y, x + 1))
+        posList.push_back(Position{int(x), int(y)});
     size_t rndIdx = size_t(GetRandomValue(0, int(posList.size()) - 1));
     res = posList[rndIdx];
   });
@@ -27,11 +27,43 @@ bool dungeon::is_tile_walkable(flecs::world &ecs, Position pos)
   bool res = false;
   dungeonDataQuery.each([&](const DungeonData &dd)
   {
-    if (pos.x < 0 || pos.x >= int(dd.width) ||
-        pos.y < 0 || pos.y >= int(dd.height))
-      return;
-    res = dd.tiles[size_t(pos.y) * dd.width + size_t(pos.x)] == dungeon::floor;
+    res = dd.walkGrid.is_walkable(pos.x, pos.y);
   });
   return res;
 }
 
+
+bool dungeon::is_tile_occupied(flecs::world &ecs, Position pos)
+{
+  static auto occupancyQuery = ecs.query<const OccupancyGrid>();
+
+  bool res = false;
+  occupancyQuery.each([&](const OccupancyGrid &og)
+  {
+    res = og.is_occupied(pos.x, pos.y);
+  });
+  return res;
+}
+
+template<typename Callable>
+static void query_occupancy(flecs::world &ecs, Callable c)
+{
+  static auto occupancyQuery = ecs.query<OccupancyGrid>();
+
+  occupancyQuery.each(c);
+}
+
+void dungeon::occupy_tile(flecs::world &ecs, Position pos)
+{
+  query_occupancy(ecs, [&](OccupancyGrid &og) { og.add(pos.x, pos.y); });
+}
+
+void dungeon::free_tile(flecs::world &ecs, Position pos)
+{
+  query_occupancy(ecs, [&](OccupancyGrid &og) { og.remove(pos.x, pos.y); });
+}
+
+void dungeon::move_occupant(flecs::world &ecs, Position from, Position to)
+{
+  query_occupancy(ecs, [&](OccupancyGrid &og) { og.move(from.x, from.y, to.x, to.y); });
+}
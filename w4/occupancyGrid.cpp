@@ -0,0 +1,40 @@
+#include "occupancyGrid.h"
+#include <algorithm>
+
+void OccupancyGrid::init(size_t w, size_t h)
+{
+  width = w;
+  height = h;
+  counts.assign(w * h, 0);
+  occupiedTiles.clear();
+}
+
+void OccupancyGrid::add(int x, int y)
+{
+  if (x < 0 || y < 0 || x >= int(width) || y >= int(height))
+    return;
+  const size_t idx = size_t(y) * width + size_t(x);
+  if (counts[idx]++ == 0)
+    occupiedTiles.push_back(uint32_t(idx));
+}
+
+void OccupancyGrid::remove(int x, int y)
+{
+  if (!is_occupied(x, y))
+    return;
+  const size_t idx = size_t(y) * width + size_t(x);
+  if (--counts[idx] > 0)
+    return;
+  // there are as many as creatures, a linear search is cheaper than an index plane
+  auto it = std::find(occupiedTiles.begin(), occupiedTiles.end(), uint32_t(idx));
+  *it = occupiedTiles.back();
+  occupiedTiles.pop_back();
+}
+
+void OccupancyGrid::move(int from_x, int from_y, int to_x, int to_y)
+{
+  if (from_x == to_x && from_y == to_y)
+    return;
+  remove(from_x, from_y);
+  add(to_x, to_y);
+}
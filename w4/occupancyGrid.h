@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Creatures standing on the tiles of the map, an overlay over DungeonData which sits on the
+// dungeon entity next to it. It's updated as creatures spawn, move and die instead of being
+// gathered from all of them, so planners and dmaps can read it every turn for free.
+// A tile holds a count, two creatures on one tile shouldn't happen but don't break it.
+class OccupancyGrid
+{
+public:
+  // creatures aren't walls, they usually move away, so going around is just more expensive
+  static constexpr float occupied_cost = 10.f;
+
+  void init(size_t width, size_t height);
+  // tiles out of the map are ignored
+  void add(int x, int y);
+  void remove(int x, int y);
+  void move(int from_x, int from_y, int to_x, int to_y);
+
+  bool is_occupied(int x, int y) const
+  {
+    if (x < 0 || y < 0 || x >= int(width) || y >= int(height))
+      return false;
+    return counts[size_t(y) * width + size_t(x)] > 0;
+  }
+  bool is_occupied(size_t idx) const { return counts[idx] > 0; }
+  // cost of entering the tile if it's walkable
+  float get_tile_cost(size_t idx) const { return counts[idx] > 0 ? occupied_cost : 1.f; }
+
+  // y * width + x of every occupied tile, in no particular order
+  const std::vector<uint32_t> &get_occupied_tiles() const { return occupiedTiles; }
+
+private:
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<uint8_t> counts;
+  std::vector<uint32_t> occupiedTiles;
+};
@@ -5,6 +5,14 @@
 #include "math.h"
 #include "aiUtils.h"
 
+// Agents going somewhere are planned together after everyone has acted, so they don't
+// walk into each other, see process_coop_movers. A straight move is there till then.
+static int plan_move(flecs::entity entity, const Position &pos, const Position &goal)
+{
+  entity.set(MoveGoal{goal.x, goal.y});
+  return move_towards(pos, goal);
+}
+
 class AttackEnemyState : public State
 {
 public:
@@ -22,7 +30,7 @@ public:
   {
     on_closest_enemy_pos(ecs, entity, [&](Action &a, const Position &pos, const Position &enemy_pos)
     {
-      a.action = move_towards(pos, enemy_pos);
+      a.action = plan_move(entity, pos, enemy_pos);
     });
   }
 };
@@ -49,12 +57,12 @@ public:
   PatrolState(float dist) : patrolDist(dist) {}
   void enter() const override {}
   void exit() const override {}
-  void act(float/* dt*/, flecs::world &, flecs::entity entity) const override
+  void act(float/* dt*/, flecs::world &/*ecs*/, flecs::entity entity) const override
   {
     entity.insert([&](const Position &pos, const PatrolPos &ppos, Action &a)
     {
       if (dist(pos, ppos) > patrolDist)
-        a.action = move_towards(pos, ppos); // do a recovery walk
+        a.action = plan_move(entity, pos, Position{ppos.x, ppos.y}); // do a recovery walk
       else
       {
         // do a random walk
@@ -103,6 +103,7 @@ struct MoveToEntity : public BehNode
         if (pos != target_pos)
         {
           a.action = move_towards(pos, target_pos);
+          entity.set(MoveGoal{target_pos.x, target_pos.y});
           res = BEH_RUNNING;
         }
         else
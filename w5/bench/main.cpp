@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "ecsTypes.h"
+#include "dungeonUtils.h"
+#include "cooperativePlanner.h"
+
+// Headless benchmark of cooperative planning against every agent going its own shortest way,
+// prints results as CSV. Moves are made in a random order like in process_actions,
+// a move into a tile which is still taken is cancelled and the turn is lost.
+// usage: hw5_coop_bench [turns]
+
+struct BenchWorld
+{
+  DungeonData dd;
+  OccupancyGrid occupancy;
+  std::vector<Position> walkable;
+};
+
+// a long drunk walk from the middle, all floor is connected
+static BenchWorld gen_bench_world(size_t size, unsigned seed)
+{
+  std::vector<char> tiles(size * size, dungeon::wall);
+  std::mt19937 rng(seed);
+  size_t x = size / 2;
+  size_t y = size / 2;
+  for (size_t numFloor = 0; numFloor < size * size / 2;)
+  {
+    char &tile = tiles[y * size + x];
+    if (tile == dungeon::wall)
+    {
+      tile = dungeon::floor;
+      numFloor++;
+    }
+    const unsigned dir = rng() % 4;
+    x = std::clamp(x + (dir == 0) - (dir == 1), size_t(1), size - 2);
+    y = std::clamp(y + (dir == 2) - (dir == 3), size_t(1), size - 2);
+  }
+  BenchWorld world{DungeonData{tiles, size, size, {}}, {}, {}};
+  world.dd.walkGrid.build(tiles.data(), size, size);
+  world.occupancy.init(size, size);
+  for (size_t i = 0; i < tiles.size(); ++i)
+    if (tiles[i] != dungeon::wall)
+      world.walkable.push_back(Position{int(i % size), int(i / size)});
+  return world;
+}
+
+static std::vector<uint32_t> gen_distances(const DungeonData &dd, Position goal)
+{
+  std::vector<uint32_t> dist(dd.width * dd.height, 0xffffffff);
+  std::vector<Position> queue{goal};
+  dist[size_t(goal.y) * dd.width + size_t(goal.x)] = 0;
+  for (size_t head = 0; head < queue.size(); ++head)
+  {
+    const Position pos = queue[head];
+    const uint32_t d = dist[size_t(pos.y) * dd.width + size_t(pos.x)];
+    for (Position next : {Position{pos.x - 1, pos.y}, Position{pos.x + 1, pos.y},
+                          Position{pos.x, pos.y - 1}, Position{pos.x, pos.y + 1}})
+    {
+      uint32_t &nd = dist[size_t(next.y) * dd.width + size_t(next.x)];
+      if (!dd.walkGrid.is_walkable(next.x, next.y) || nd != 0xffffffff)
+        continue;
+      nd = d + 1;
+      queue.push_back(next);
+    }
+  }
+  return dist;
+}
+
+static Position move_pos(Position pos, int action)
+{
+  if (action == EA_MOVE_LEFT)
+    pos.x--;
+  else if (action == EA_MOVE_RIGHT)
+    pos.x++;
+  else if (action == EA_MOVE_UP)
+    pos.y--;
+  else if (action == EA_MOVE_DOWN)
+    pos.y++;
+  return pos;
+}
+
+struct TurnStats
+{
+  double planMs = 0.0;
+  double maxPlanMs = 0.0;
+  size_t moves = 0;
+  size_t attacks = 0;
+  size_t cancelled = 0;
+  size_t waits = 0;
+  size_t expanded = 0;
+  size_t treeExpanded = 0;
+};
+
+// All agents chase the player who stands still, or with `roam` half of them walk to random tiles
+// and get a new one when they're there. Independent agents step to the neighbour closest to the goal.
+static void run_scenario(size_t size, size_t num_agents, bool roam, bool cooperative, size_t num_turns)
+{
+  BenchWorld world = gen_bench_world(size, 1);
+  std::mt19937 rng(2);
+  std::shuffle(world.walkable.begin(), world.walkable.end(), rng);
+  const Position player = world.walkable[0];
+  world.occupancy.add(player.x, player.y);
+  std::vector<CoopAgent> agents;
+  for (size_t i = 1; i <= num_agents && i < world.walkable.size(); ++i)
+  {
+    const Position goal = roam && i % 2 ? world.walkable[rng() % world.walkable.size()] : player;
+    agents.push_back(CoopAgent{world.walkable[i], goal});
+    world.occupancy.add(world.walkable[i].x, world.walkable[i].y);
+  }
+
+  CooperativePlanner planner;
+  std::vector<std::vector<uint32_t>> distances;
+  std::vector<Position> distanceGoals;
+  auto get_distances = [&](Position goal) -> const std::vector<uint32_t> &
+  {
+    for (size_t i = 0; i < distanceGoals.size(); ++i)
+      if (distanceGoals[i] == goal)
+        return distances[i];
+    distanceGoals.push_back(goal);
+    distances.push_back(gen_distances(world.dd, goal));
+    return distances.back();
+  };
+
+  TurnStats stats;
+  std::vector<size_t> order(agents.size());
+  for (size_t turn = 0; turn < num_turns; ++turn)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    if (cooperative)
+    {
+      planner.plan(world.dd, world.occupancy, agents);
+      stats.expanded += planner.get_stats().numExpanded;
+      stats.treeExpanded += planner.get_stats().numTreeExpanded;
+    }
+    else
+    {
+      // the same as a follower of a dijkstra map or a single agent A*, nobody else is known
+      distances.clear();
+      distanceGoals.clear();
+      for (CoopAgent &agent : agents)
+      {
+        const std::vector<uint32_t> &dist = get_distances(agent.goal);
+        uint32_t best = dist[size_t(agent.pos.y) * size + size_t(agent.pos.x)];
+        agent.move = EA_NOP;
+        for (int move = EA_MOVE_START; move < EA_MOVE_END; ++move)
+        {
+          const Position next = move_pos(agent.pos, move);
+          const uint32_t d = dist[size_t(next.y) * size + size_t(next.x)];
+          if (world.dd.walkGrid.is_walkable(next.x, next.y) && d < best)
+          {
+            best = d;
+            agent.move = move;
+          }
+        }
+      }
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.planMs += ms;
+    stats.maxPlanMs = std::max(stats.maxPlanMs, ms);
+
+    for (size_t i = 0; i < order.size(); ++i)
+      order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    for (size_t i : order)
+    {
+      CoopAgent &agent = agents[i];
+      if (agent.move == EA_NOP)
+      {
+        stats.waits++;
+        continue;
+      }
+      const Position next = move_pos(agent.pos, agent.move);
+      if (next == player)
+        stats.attacks++;
+      else if (world.occupancy.is_occupied(next.x, next.y))
+        stats.cancelled++;
+      else
+      {
+        world.occupancy.move(agent.pos.x, agent.pos.y, next.x, next.y);
+        agent.pos = next;
+        stats.moves++;
+        if (agent.pos == agent.goal)
+          agent.goal = world.walkable[rng() % world.walkable.size()];
+      }
+    }
+  }
+  const double turns = double(num_turns);
+  printf("%zu,%zu,%s,%s,%zu,%.3f,%.3f,%.0f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%zu\n", size, agents.size(),
+         roam ? "roam" : "chase", cooperative ? "whca" : "independent", num_turns, stats.planMs / turns,
+         stats.maxPlanMs, double(agents.size()) * turns / (stats.planMs * 1e-3), double(stats.moves) / turns,
+         double(stats.attacks) / turns, double(stats.cancelled) / turns, double(stats.waits) / turns,
+         double(stats.expanded) / (turns * double(agents.size())),
+         double(stats.treeExpanded) / (turns * double(agents.size())),
+         cooperative ? planner.get_allocated_bytes() : size_t(0));
+}
+
+int main(int argc, const char **argv)
+{
+  const size_t numTurns = argc > 1 ? size_t(atoi(argv[1])) : 50;
+  constexpr size_t sizes[] = {50, 128};
+  constexpr size_t agentCounts[] = {50, 200, 400, 800};
+
+  printf("size,agents,scenario,planner,turns,avg_plan_ms,max_plan_ms,agents_per_sec,"
+         "moves_per_turn,attacks_per_turn,cancelled_per_turn,waits_per_turn,expanded_per_agent,"
+         "tree_expanded_per_agent,planner_bytes\n");
+  for (size_t size : sizes)
+    for (size_t numAgents : agentCounts)
+    {
+      // half of the map is floor, with more than a third of it taken there is no room to move
+      if (numAgents * 3 > size * size / 2)
+        continue;
+      for (bool roam : {false, true})
+        for (bool cooperative : {false, true})
+          run_scenario(size, numAgents, roam, cooperative, numTurns);
+    }
+  return 0;
+}
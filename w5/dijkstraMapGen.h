@@ -1,11 +1,31 @@
 #pragma once
 #include <vector>
 #include <flecs.h>
+#include "incrementalDmap.h"
 
 namespace dmaps
 {
+  // Full builds, the maps below are repaired to the same values.
   void gen_player_approach_map(flecs::world &ecs, std::vector<float> &map);
   void gen_player_flee_map(flecs::world &ecs, std::vector<float> &map);
   void gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map);
+
+  // Maps are kept between turns: each is repaired by the IncrementalDmap which built it, stored
+  // on the same map entity, where sources moved and creatures changed tile costs. A map of the
+  // wrong size is built from scratch. The flee map follows the approach map, they're updated together.
+  void update_player_maps(flecs::world &ecs, std::vector<float> &approach_map, IncrementalDmap &approach_dmap,
+                          std::vector<float> &flee_map, IncrementalDmap &flee_dmap);
+  void update_hive_pack_map(flecs::world &ecs, std::vector<float> &map, IncrementalDmap &dmap);
+
+  // The same without the ecs, for the headless bench. Sources are the tiles of the player or of hives,
+  // the flee map is made of the approach one.
+  void gen_sources_map(const DungeonData &dd, const OccupancyGrid &occupancy, const std::vector<uint32_t> &sources,
+                       std::vector<float> &map);
+  void gen_flee_map(const DungeonData &dd, const OccupancyGrid &occupancy, const std::vector<float> &approach_map,
+                    std::vector<float> &map);
+  void update_sources_map(const DungeonData &dd, const OccupancyGrid &occupancy, const std::vector<uint32_t> &sources,
+                          std::vector<float> &map, IncrementalDmap &dmap);
+  void update_flee_map(const DungeonData &dd, const OccupancyGrid &occupancy, const std::vector<float> &approach_map,
+                       const IncrementalDmap &approach_dmap, std::vector<float> &map, IncrementalDmap &dmap);
 };
 
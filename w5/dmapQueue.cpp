@@ -0,0 +1,109 @@
+#include "dmapQueue.h"
+#include <algorithm>
+
+bool DmapQueue::process_sources(std::vector<float> &map, const DungeonData &dd, const OccupancyGrid &occupancy,
+                                const std::vector<uint32_t> &sources, size_t max_written)
+{
+  set_seeds(map, dd, sources);
+  return propagate(map, dd, occupancy, max_written);
+}
+
+void DmapQueue::relax(std::vector<float> &map, const DungeonData &dd, const OccupancyGrid &occupancy)
+{
+  tiles.clear();
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = dd.walkGrid.find_walkable_in_row(y, 0); x < dd.width;
+         x = dd.walkGrid.find_walkable_in_row(y, x + 1))
+      if (map[y * dd.width + x] < invalid_tile_value)
+        tiles.push_back(uint32_t(y * dd.width + x));
+  set_seeds(map, dd, tiles);
+  propagate(map, dd, occupancy, SIZE_MAX);
+}
+
+void DmapQueue::set_seeds(const std::vector<float> &map, const DungeonData &dd, const std::vector<uint32_t> &candidates)
+{
+  seeds.clear();
+  seedOffsets.clear();
+  base = invalid_tile_value;
+  for (uint32_t idx : candidates)
+    if (dd.walkGrid.is_walkable(int(idx % dd.width), int(idx / dd.width)))
+      base = std::min(base, map[idx]);
+  if (base == invalid_tile_value)
+    return;
+  for (uint32_t idx : candidates)
+  {
+    if (!dd.walkGrid.is_walkable(int(idx % dd.width), int(idx / dd.width)) || map[idx] >= invalid_tile_value)
+      continue;
+    const size_t bucket = get_bucket(map[idx]);
+    if (bucket + 2 > seedOffsets.size())
+      seedOffsets.resize(bucket + 2, 0);
+    seedOffsets[bucket + 1]++;
+  }
+  for (size_t i = 1; i < seedOffsets.size(); ++i)
+    seedOffsets[i] += seedOffsets[i - 1];
+  seeds.resize(seedOffsets.back());
+  for (uint32_t idx : candidates)
+    if (dd.walkGrid.is_walkable(int(idx % dd.width), int(idx / dd.width)) && map[idx] < invalid_tile_value)
+      seeds[seedOffsets[get_bucket(map[idx])]++] = idx;
+  // offsets were moved to the ends while filling
+  for (size_t i = seedOffsets.size() - 1; i > 0; --i)
+    seedOffsets[i] = seedOffsets[i - 1];
+  seedOffsets[0] = 0;
+}
+
+bool DmapQueue::propagate(std::vector<float> &map, const DungeonData &dd, const OccupancyGrid &occupancy,
+                          size_t max_written)
+{
+  written.clear();
+  const size_t numSeedBuckets = seedOffsets.empty() ? 0 : seedOffsets.size() - 1;
+  size_t numQueued = 0;
+  auto relax_to = [&](float value, int x, int y)
+  {
+    if (!dd.walkGrid.is_walkable(x, y))
+      return;
+    const size_t idx = size_t(y) * dd.width + size_t(x);
+    const float cost = occupancy.get_tile_cost(idx);
+    if (value < map[idx] - cost)
+    {
+      map[idx] = value + cost;
+      ring[get_bucket(map[idx]) % ring_size].push_back(uint32_t(idx));
+      written.push_back(uint32_t(idx));
+      numQueued++;
+    }
+  };
+  for (size_t bucket = 0; bucket < numSeedBuckets || numQueued > 0; ++bucket)
+  {
+    std::vector<uint32_t> &cur = ring[bucket % ring_size];
+    if (bucket < numSeedBuckets)
+      for (size_t i = seedOffsets[bucket]; i < seedOffsets[bucket + 1]; ++i)
+        // a seed which was improved already is queued in an earlier bucket
+        if (get_bucket(map[seeds[i]]) == bucket)
+        {
+          cur.push_back(seeds[i]);
+          numQueued++;
+        }
+    // values just over a bucket border can be rounded into this one, so it can grow here
+    for (size_t i = 0; i < cur.size(); ++i)
+    {
+      const uint32_t idx = cur[i];
+      const float value = map[idx];
+      if (get_bucket(value) != bucket)
+        continue;
+      const int x = int(idx % dd.width);
+      const int y = int(idx / dd.width);
+      relax_to(value, x - 1, y);
+      relax_to(value, x + 1, y);
+      relax_to(value, x, y - 1);
+      relax_to(value, x, y + 1);
+    }
+    numQueued -= cur.size();
+    cur.clear();
+    if (written.size() > max_written)
+    {
+      for (std::vector<uint32_t> &queued : ring)
+        queued.clear();
+      return false;
+    }
+  }
+  return true;
+}
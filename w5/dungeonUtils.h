@@ -9,4 +9,10 @@ namespace dungeon
 
   Position find_walkable_tile(flecs::world &ecs);
   bool is_tile_walkable(flecs::world &ecs, Position pos);
+
+  // OccupancyGrid of the dungeon, creatures should call these when they spawn, move and die
+  bool is_tile_occupied(flecs::world &ecs, Position pos);
+  void occupy_tile(flecs::world &ecs, Position pos);
+  void free_tile(flecs::world &ecs, Position pos);
+  void move_occupant(flecs::world &ecs, Position from, Position to);
 };
@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include "walkGrid.h"
+#include "occupancyGrid.h"
 
 // TODO: make a lot of seprate files
 struct Position;
@@ -56,6 +58,13 @@ struct PatrolPos
   int y = 0;
 };
 
+// tile the creature wants to go to this turn, moves of all of them are planned together
+struct MoveGoal
+{
+  int x = 0;
+  int y = 0;
+};
+
 struct Hitpoints
 {
   float hitpoints = 10.f;
@@ -143,6 +152,7 @@ struct DungeonData
   std::vector<char> tiles; // for pathfinding
   size_t width;
   size_t height;
+  WalkGrid walkGrid; // derived from tiles, should be updated together with them
 };
 
 struct DijkstraMapData
@@ -0,0 +1,221 @@
+#include "incrementalDmap.h"
+#include <algorithm>
+#include <numeric>
+
+template<typename Callable>
+static void for_each_walkable_neighbour(const DungeonData &dd, uint32_t idx, Callable c)
+{
+  const int x = int(idx % dd.width);
+  const int y = int(idx / dd.width);
+  if (dd.walkGrid.is_walkable(x - 1, y))
+    c(idx - 1);
+  if (dd.walkGrid.is_walkable(x + 1, y))
+    c(idx + 1);
+  if (dd.walkGrid.is_walkable(x, y - 1))
+    c(uint32_t(idx - dd.width));
+  if (dd.walkGrid.is_walkable(x, y + 1))
+    c(uint32_t(idx + dd.width));
+}
+
+static bool is_walkable(const DungeonData &dd, uint32_t idx)
+{
+  return dd.walkGrid.is_walkable(int(idx % dd.width), int(idx / dd.width));
+}
+
+void IncrementalDmap::set_seed(uint32_t idx, float value)
+{
+  if (idx >= seeds.size())
+    seeds.resize(idx + 1, invalid_tile_value);
+  if (seeds[idx] == value)
+    return;
+  seeds[idx] = value;
+  changedSeeds.push_back(idx);
+}
+
+void IncrementalDmap::set_sources(const std::vector<uint32_t> &tiles)
+{
+  // a source which stays is changed twice here, update sees it didn't change
+  for (uint32_t idx : sourceTiles)
+    set_seed(idx, invalid_tile_value);
+  for (uint32_t idx : tiles)
+    set_seed(idx, 0.f);
+  sourceTiles = tiles;
+}
+
+void IncrementalDmap::reset(const DungeonData &dd, std::vector<float> &map)
+{
+  width = dd.width;
+  height = dd.height;
+  map.assign(width * height, invalid_tile_value);
+  seeds.resize(width * height, invalid_tile_value);
+  changedSeeds.clear();
+  for (size_t i = 0; i < seeds.size(); ++i)
+    if (seeds[i] < invalid_tile_value)
+      changedSeeds.push_back(uint32_t(i));
+  wasOccupied.assign(width * height, 0);
+  occupiedTiles.clear();
+  stamps.assign(width * height, 0);
+  stamp = 0;
+}
+
+void IncrementalDmap::rebuild(const DungeonData &dd, const OccupancyGrid &occupancy, std::vector<float> &map)
+{
+  // the same as a full build of the flee map, seeds are the map with every other tile invalid
+  map = seeds;
+  queue.relax(map, dd, occupancy);
+  changedTiles.resize(map.size());
+  std::iota(changedTiles.begin(), changedTiles.end(), 0u);
+  changedSeeds.clear();
+  for (uint32_t idx : occupiedTiles)
+    wasOccupied[idx] = 0;
+  occupiedTiles = occupancy.get_occupied_tiles();
+  for (uint32_t idx : occupiedTiles)
+    wasOccupied[idx] = 1;
+}
+
+void IncrementalDmap::mark_changed(uint32_t idx)
+{
+  if (stamps[idx] == stamp)
+    return;
+  stamps[idx] = stamp;
+  changedTiles.push_back(idx);
+}
+
+bool IncrementalDmap::is_supported(const DungeonData &dd, const OccupancyGrid &occupancy,
+                                   const std::vector<float> &map, uint32_t idx) const
+{
+  const float value = map[idx];
+  if (seeds[idx] <= value)
+    return true;
+  if (!is_walkable(dd, idx))
+    return false;
+  // the same sum the value was made with when it was relaxed from this neighbour
+  const float cost = occupancy.get_tile_cost(idx);
+  bool supported = false;
+  for_each_walkable_neighbour(dd, idx, [&](uint32_t n)
+  {
+    supported |= map[n] < invalid_tile_value && map[n] + cost <= value;
+  });
+  return supported;
+}
+
+bool IncrementalDmap::lower_from_neighbours(const DungeonData &dd, const OccupancyGrid &occupancy,
+                                            std::vector<float> &map, uint32_t idx) const
+{
+  const float before = map[idx];
+  if (seeds[idx] < map[idx])
+    map[idx] = seeds[idx];
+  if (!is_walkable(dd, idx))
+    return map[idx] < before;
+  // the same comparison as DmapQueue relaxes with
+  const float cost = occupancy.get_tile_cost(idx);
+  for_each_walkable_neighbour(dd, idx, [&](uint32_t n)
+  {
+    if (map[n] < map[idx] - cost)
+      map[idx] = map[n] + cost;
+  });
+  return map[idx] < before;
+}
+
+void IncrementalDmap::update(const DungeonData &dd, const OccupancyGrid &occupancy, std::vector<float> &map)
+{
+  if (width != dd.width || height != dd.height || map.size() != width * height || seeds.size() != width * height)
+    reset(dd, map);
+  if (++stamp == 0)
+  {
+    std::fill(stamps.begin(), stamps.end(), 0);
+    stamp = 1;
+  }
+  changedTiles.clear();
+  lowerSeeds.clear();
+  raiseQueue.clear();
+  // when most of the map changes, like after the player made a step, repairs cost more
+  // than building it again, so they give up after touching a part of the tiles
+  const size_t workBudget = map.size() / rebuild_fraction;
+  // creatures which left make tiles cheaper, ones which came make them dearer
+  const std::vector<uint32_t> &occupied = occupancy.get_occupied_tiles();
+  size_t numLeft = 0;
+  for (uint32_t idx : occupiedTiles)
+    numLeft += !occupancy.is_occupied(size_t(idx));
+  for (uint32_t idx : occupied)
+    if (!wasOccupied[idx])
+      raiseQueue.push_back(idx);
+  // every change touches at least its own tile, with more of them than the budget
+  // the repair would give up anyway, so the work before that is skipped
+  const size_t numChanges = changedSeeds.size() + numLeft + raiseQueue.size();
+  if (numChanges > workBudget)
+  {
+    rebuild(dd, occupancy, map);
+    return;
+  }
+
+  for (uint32_t idx : occupiedTiles)
+    if (!occupancy.is_occupied(size_t(idx)) && lower_from_neighbours(dd, occupancy, map, idx))
+    {
+      mark_changed(idx);
+      lowerSeeds.push_back(idx);
+    }
+  for (uint32_t idx : occupiedTiles)
+    wasOccupied[idx] = 0;
+  occupiedTiles = occupied;
+  for (uint32_t idx : occupiedTiles)
+    wasOccupied[idx] = 1;
+
+  for (uint32_t idx : changedSeeds)
+  {
+    if (seeds[idx] < map[idx])
+    {
+      map[idx] = seeds[idx];
+      mark_changed(idx);
+      lowerSeeds.push_back(idx);
+    }
+    else if (seeds[idx] > map[idx])
+      raiseQueue.push_back(idx);
+  }
+  changedSeeds.clear();
+
+  if (!queue.process_sources(map, dd, occupancy, lowerSeeds, workBudget - numChanges))
+  {
+    rebuild(dd, occupancy, map);
+    return;
+  }
+  for (uint32_t idx : queue.get_written_tiles())
+    mark_changed(idx);
+
+  // A tile which has neither its seed nor a neighbour its value could've come from is invalidated
+  // and its neighbours with larger values, which could've come from it, are checked next.
+  // Order doesn't matter: a tile which was kept because of a neighbour invalidated later is checked again.
+  raisedTiles.clear();
+  const size_t numLowered = queue.get_written_tiles().size();
+  for (size_t i = 0; i < raiseQueue.size(); ++i)
+  {
+    if (numChanges + numLowered + i > workBudget)
+    {
+      rebuild(dd, occupancy, map);
+      return;
+    }
+    const uint32_t idx = raiseQueue[i];
+    const float value = map[idx];
+    if (value >= invalid_tile_value || is_supported(dd, occupancy, map, idx))
+      continue;
+    map[idx] = invalid_tile_value;
+    raisedTiles.push_back(idx);
+    mark_changed(idx);
+    if (!is_walkable(dd, idx))
+      continue;
+    for_each_walkable_neighbour(dd, idx, [&](uint32_t n)
+    {
+      if (map[n] > value && map[n] < invalid_tile_value)
+        raiseQueue.push_back(n);
+    });
+  }
+
+  // the hole is filled from its own seeds and the valid tiles around it
+  lowerSeeds.clear();
+  for (uint32_t idx : raisedTiles)
+    if (lower_from_neighbours(dd, occupancy, map, idx))
+      lowerSeeds.push_back(idx);
+  queue.process_sources(map, dd, occupancy, lowerSeeds);
+  for (uint32_t idx : queue.get_written_tiles())
+    mark_changed(idx);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "dmapQueue.h"
+
+// A dijkstra map which is kept between turns and repaired instead of being built again.
+// Seeds are tiles with a value of their own, 0 for sources. Between updates seeds can change
+// and creatures can come and go changing tile costs, update then only touches what depends on it:
+//  - lower: new or lower seeds and cheaper tiles are relaxed outwards like in a full build,
+//  - raise: tiles which lost what their values came from are invalidated, then their dependants,
+//    and the hole is filled from the valid tiles around it.
+// The result is the same as a full build, a map of arbitrary seeds like the flee one can only
+// differ in rounding. A repair which grows too big gives up and the map is built again,
+// so the worst turn costs about as much as a full build. Changed seeds and tiles creatures
+// came to or left count towards that size, with too many of them there's no repair at all.
+class IncrementalDmap
+{
+public:
+  // seed of a tile, invalid_tile_value removes it
+  void set_seed(uint32_t idx, float value);
+  // seeds with value 0 on these tiles and nowhere else
+  void set_sources(const std::vector<uint32_t> &tiles);
+
+  // map is the one from the previous update, it's built from scratch if the size differs
+  void update(const DungeonData &dd, const OccupancyGrid &occupancy, std::vector<float> &map);
+
+  // tiles whose values might've changed in the last update, each once
+  const std::vector<uint32_t> &get_changed_tiles() const { return changedTiles; }
+
+private:
+  // a repair which touches more than this part of the tiles builds the map again
+  static constexpr size_t rebuild_fraction = 16;
+
+  void reset(const DungeonData &dd, std::vector<float> &map);
+  void rebuild(const DungeonData &dd, const OccupancyGrid &occupancy, std::vector<float> &map);
+  void mark_changed(uint32_t idx);
+  bool is_supported(const DungeonData &dd, const OccupancyGrid &occupancy, const std::vector<float> &map,
+                    uint32_t idx) const;
+  // takes the seed or the best neighbour if it's lower, true if the tile got lower
+  bool lower_from_neighbours(const DungeonData &dd, const OccupancyGrid &occupancy, std::vector<float> &map,
+                             uint32_t idx) const;
+
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<float> seeds; // by tile
+  std::vector<uint32_t> sourceTiles;
+  std::vector<uint32_t> changedSeeds; // since the last update
+  // occupancy the map was built with
+  std::vector<uint8_t> wasOccupied;
+  std::vector<uint32_t> occupiedTiles;
+  std::vector<uint32_t> stamps; // by tile, for sets of tiles without clearing
+  uint32_t stamp = 0;
+
+  DmapQueue queue;
+  std::vector<uint32_t> lowerSeeds;
+  std::vector<uint32_t> raiseQueue;
+  std::vector<uint32_t> raisedTiles;
+  std::vector<uint32_t> changedTiles;
+};
@@ -11,26 +11,18 @@ flecs::entity create_hive(flecs::entity e)
 
 static Position find_free_dungeon_tile(flecs::world &ecs)
 {
-  static auto findMonstersQuery = ecs.query<const Position, const Hitpoints>();
-  bool done = false;
-  while (!done)
+  while (true)
   {
-    done = true;
     Position pos = dungeon::find_walkable_tile(ecs);
-    findMonstersQuery.each([&](const Position &p, const Hitpoints&)
-    {
-      if (p == pos)
-        done = false;
-    });
-    if (done)
+    if (!dungeon::is_tile_occupied(ecs, pos))
       return pos;
-  };
-  return {0, 0};
+  }
 }
 
 flecs::entity create_monster(flecs::world &ecs, Color col, const char *texture_src)
 {
   Position pos = find_free_dungeon_tile(ecs);
+  dungeon::occupy_tile(ecs, pos);
 
   flecs::entity textureSrc = ecs.entity(texture_src);
   return ecs.entity()
@@ -49,6 +41,7 @@ flecs::entity create_monster(flecs::world &ecs, Color col, const char *texture_s
 void create_player(flecs::world &ecs, const char *texture_src)
 {
   Position pos = find_free_dungeon_tile(ecs);
+  dungeon::occupy_tile(ecs, pos);
 
   flecs::entity textureSrc = ecs.entity(texture_src);
   ecs.entity("player")
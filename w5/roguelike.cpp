@@ -8,6 +8,7 @@
 #include "dungeonUtils.h"
 #include "dijkstraMapGen.h"
 #include "dmapFollower.h"
+#include "coopMover.h"
 #include "dmapBeh.h"
 #include "rlikeObjects.h"
 
@@ -166,8 +167,13 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
       dungeonData[y * w + x] = tiles[y * w + x];
+  DungeonData dd{dungeonData, w, h, {}};
+  dd.walkGrid.build(tiles, w, h);
+  OccupancyGrid occupancy;
+  occupancy.init(w, h);
   ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
+    .set(dd)
+    .set(occupancy);
 
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
@@ -253,22 +259,27 @@ static void process_actions(flecs::world &ecs)
     {
       Position nextPos = move_pos(pos, a.action);
       bool blocked = !dungeon::is_tile_walkable(ecs, nextPos);
-      checkAttacks.each([&](flecs::entity enemy, const MovePos &epos, Hitpoints &hp, const Team &enemy_team)
-      {
-        if (entity != enemy && epos == nextPos)
+      // the grid follows move positions, there's nobody to bump into on a free tile
+      if (dungeon::is_tile_occupied(ecs, nextPos))
+        checkAttacks.each([&](flecs::entity enemy, const MovePos &epos, Hitpoints &hp, const Team &enemy_team)
         {
-          blocked = true;
-          if (team.team != enemy_team.team)
+          if (entity != enemy && epos == nextPos)
           {
-            push_to_log(ecs, "damaged entity");
-            hp.hitpoints -= dmg.damage;
+            blocked = true;
+            if (team.team != enemy_team.team)
+            {
+              push_to_log(ecs, "damaged entity");
+              hp.hitpoints -= dmg.damage;
+            }
           }
-        }
-      });
+        });
       if (blocked)
         a.action = EA_NOP;
       else
+      {
+        dungeon::move_occupant(ecs, pos, nextPos);
         mpos = nextPos;
+      }
     });
     // now move
     processActions.each([&](Action &a, Position &pos, MovePos &mpos, const MeleeDamage &, const Team&)
@@ -278,13 +289,16 @@ static void process_actions(flecs::world &ecs)
     });
   });
 
-  static auto deleteAllDead = ecs.query<const Hitpoints>();
+  static auto deleteAllDead = ecs.query<const Hitpoints, const Position>();
   ecs.defer([&]
   {
-    deleteAllDead.each([&](flecs::entity entity, const Hitpoints &hp)
+    deleteAllDead.each([&](flecs::entity entity, const Hitpoints &hp, const Position &pos)
     {
       if (hp.hitpoints <= 0.f)
+      {
+        dungeon::free_tile(ecs, pos);
         entity.destruct();
+      }
     });
   });
 
@@ -377,24 +391,24 @@ void process_turn(flecs::world &ecs)
         });
         process_dmap_followers(ecs);
       });
+      process_coop_movers(ecs);
       turnIncrementer.each([](TurnCounter &tc) { tc.count++; });
     }
     process_actions(ecs);
 
-    std::vector<float> approachMap;
-    dmaps::gen_player_approach_map(ecs, approachMap);
-    ecs.entity("approach_map")
-      .set(DijkstraMapData{approachMap});
-
-    std::vector<float> fleeMap;
-    dmaps::gen_player_flee_map(ecs, fleeMap);
-    ecs.entity("flee_map")
-      .set(DijkstraMapData{fleeMap});
+    // maps of the last turn are repaired in place
+    ecs.entity("approach_map").insert([&](DijkstraMapData &approachMap, IncrementalDmap &approachDmap)
+    {
+      ecs.entity("flee_map").insert([&](DijkstraMapData &fleeMap, IncrementalDmap &fleeDmap)
+      {
+        dmaps::update_player_maps(ecs, approachMap.map, approachDmap, fleeMap.map, fleeDmap);
+      });
+    });
 
-    std::vector<float> hiveMap;
-    dmaps::gen_hive_pack_map(ecs, hiveMap);
-    ecs.entity("hive_map")
-      .set(DijkstraMapData{hiveMap});
+    ecs.entity("hive_map").insert([&](DijkstraMapData &hiveMap, IncrementalDmap &hiveDmap)
+    {
+      dmaps::update_hive_pack_map(ecs, hiveMap.map, hiveDmap);
+    });
 
     //ecs.entity("flee_map").add<VisualiseMap>();
     ecs.entity("hive_follower_sum")
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Search state which could be reused between queries on the same map.
+// Per-tile data is stamped with the generation of the query which wrote it,
+// so starting a new query neither reallocates nor clears anything.
+class AStarContext
+{
+public:
+  static constexpr uint32_t invalid_idx = 0xffffffff;
+
+  // Starts new query on a map of given size, reallocates only if the size has changed.
+  void begin_query(size_t width, size_t height);
+
+  size_t get_width() const { return width; }
+  size_t get_height() const { return height; }
+
+  bool is_visited(uint32_t idx) const { return tiles[idx].gen == gen; }
+  float get_g(uint32_t idx) const { return is_visited(idx) ? tiles[idx].g : max_g; }
+  uint32_t get_prev(uint32_t idx) const { return is_visited(idx) ? tiles[idx].prev : invalid_idx; }
+
+  bool is_closed(uint32_t idx) const
+  {
+    const size_t word = idx >> 6;
+    return closedGen[word] == gen && (closed[word] >> (idx & 63)) & 1;
+  }
+  void close(uint32_t idx)
+  {
+    const size_t word = idx >> 6;
+    if (closedGen[word] != gen)
+    {
+      closedGen[word] = gen;
+      closed[word] = 0;
+    }
+    closed[word] |= uint64_t(1) << (idx & 63);
+  }
+
+  // Inserts tile into open list or decreases its key if it's already there.
+  void push(uint32_t idx, float g, float f, uint32_t prev);
+
+  bool empty() const { return heap.empty(); }
+  uint32_t top() const { return heap.front().idx; }
+  float top_f() const { return heap.front().f; }
+  uint32_t pop();
+
+  size_t get_open_size() const { return heap.size(); }
+  size_t get_allocated_bytes() const;
+
+  // stats of the current query
+  size_t numExpanded = 0;
+  size_t numPushed = 0;
+
+private:
+  static constexpr float max_g = 3.402823466e+38f;
+
+  struct TileState
+  {
+    uint32_t gen = 0;
+    uint32_t heapIdx = invalid_idx;
+    uint32_t prev = invalid_idx;
+    float g = 0.f;
+  };
+
+  struct HeapNode
+  {
+    float f;
+    uint32_t idx;
+  };
+
+  void sift_up(size_t pos);
+  void sift_down(size_t pos);
+
+  size_t width = 0;
+  size_t height = 0;
+  uint32_t gen = 0;
+  std::vector<TileState> tiles;
+  std::vector<HeapNode> heap;
+  // closed set, one bit per tile, each word has its own generation
+  std::vector<uint64_t> closed;
+  std::vector<uint32_t> closedGen;
+};
+
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <tuple>
+#include <thread>
+#include <vector>
+#include "ecsTypes.h"
+#include "math.h"
+#include "dungeonUtils.h"
+#include "pathfinder.h"
+#include "hpaPathfinder.h"
+#include "pathBatch.h"
+#include "pathCache.h"
+
+// Headless benchmark of the hierarchical pathfinding, prints results as CSV.
+// usage: hw7_bench [requests] - batches of path requests against the number of threads
+//        hw7_bench cache [agents] - agents chasing the player through the path cache on a large map
+//        hw7_bench repair [size] [edits] - repairs of the portal graph after tile edits against full builds,
+//                                          exits with 1 if a repaired graph differs
+
+static const std::vector<size_t> bench_cluster_sizes = {8, 64, 512};
+
+struct BenchMap
+{
+  DungeonData dd;
+  DungeonPortals dp;
+  MapRegions regions;
+  std::vector<IVec2> walkable;
+};
+
+// a long drunk walk from the middle, all floor is connected
+static BenchMap gen_bench_map(size_t size, unsigned seed)
+{
+  std::vector<char> tiles(size * size, dungeon::wall);
+  std::mt19937 rng(seed);
+  size_t x = size / 2;
+  size_t y = size / 2;
+  for (size_t numFloor = 0; numFloor < size * size / 2;)
+  {
+    char &tile = tiles[y * size + x];
+    if (tile == dungeon::wall)
+    {
+      tile = dungeon::floor;
+      numFloor++;
+    }
+    const unsigned dir = rng() % 4;
+    x = std::clamp(x + (dir == 0) - (dir == 1), size_t(1), size - 2);
+    y = std::clamp(y + (dir == 2) - (dir == 3), size_t(1), size - 2);
+  }
+  BenchMap map{DungeonData{tiles, size, size, {}}, {}, {}, {}};
+  map.dd.walkGrid.build(tiles.data(), size, size);
+  map.dp = build_dungeon_portals(map.dd, bench_cluster_sizes);
+  map.regions.build(tiles.data(), size, size);
+  for (size_t i = 0; i < tiles.size(); ++i)
+    if (tiles[i] != dungeon::wall)
+      map.walkable.push_back(IVec2{int(i % size), int(i / size)});
+  return map;
+}
+
+static std::vector<PathRequest> gen_requests(const BenchMap &map, size_t count, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::vector<PathRequest> res;
+  for (size_t i = 0; i < count; ++i)
+    res.push_back(PathRequest{map.walkable[rng() % map.walkable.size()], map.walkable[rng() % map.walkable.size()]});
+  return res;
+}
+
+static double get_ms(std::chrono::steady_clock::time_point from)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - from).count();
+}
+
+// All requests at once like at the start of a turn, with 1 thread and up to all hardware ones.
+// Paths of every thread count are checked against the single thread ones.
+static void run_batches(size_t size, size_t num_requests)
+{
+  const BenchMap map = gen_bench_map(size, 1);
+  const std::vector<PathRequest> requests = gen_requests(map, num_requests, 2);
+  std::vector<PathResult> results(requests.size());
+  std::vector<IVec2> arena;
+  PathBatchContext ctx;
+  // the first run only finds out how big the arena should be
+  arena.resize(find_paths(ctx, map.dd, map.dp, &map.regions, requests, results, arena, 1));
+
+  std::vector<std::vector<IVec2>> expected;
+  double singleMs = 0.0;
+  // counts over the hardware threads only show the overhead of the workers
+  std::vector<size_t> threadCounts = {1, 2, 4, 8};
+  for (size_t numThreads = 16; numThreads <= std::thread::hardware_concurrency(); numThreads *= 2)
+    threadCounts.push_back(numThreads);
+  for (size_t numThreads : threadCounts)
+  {
+    // best of a few, batches are short and threads take a while to start
+    constexpr int numRuns = 5;
+    double bestMs = 0.0;
+    for (int run = 0; run < numRuns; ++run)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      find_paths(ctx, map.dd, map.dp, &map.regions, requests, results, arena, numThreads);
+      const double ms = get_ms(start);
+      bestMs = run == 0 ? ms : std::min(bestMs, ms);
+    }
+    if (numThreads == 1)
+      singleMs = bestMs;
+
+    size_t numFound = 0;
+    size_t numTiles = 0;
+    size_t numDifferent = 0;
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+      const PathResult &result = results[i];
+      const std::span<const IVec2> path = result.status == PathResult::Status::Found
+        ? std::span<const IVec2>(arena).subspan(result.offset, result.length)
+        : std::span<const IVec2>();
+      numFound += result.status == PathResult::Status::Found;
+      numTiles += path.size();
+      if (numThreads == 1)
+        expected.emplace_back(path.begin(), path.end());
+      else
+        numDifferent += !std::equal(path.begin(), path.end(), expected[i].begin(), expected[i].end());
+    }
+    printf("%zu,%zu,%zu,%.3f,%.2f,%zu,%zu,%zu\n", size, requests.size(), numThreads, bestMs, singleMs / bestMs,
+           numFound, numTiles, numDifferent);
+  }
+}
+
+static bool is_valid_path(const DungeonData &dd, const std::vector<IVec2> &path, IVec2 from, IVec2 to)
+{
+  if (path.empty() || path.front() != from || path.back() != to)
+    return false;
+  for (size_t i = 0; i < path.size(); ++i)
+  {
+    if (!dd.walkGrid.is_walkable(path[i].x, path[i].y))
+      return false;
+    if (i > 0 && std::abs(path[i].x - path[i - 1].x) + std::abs(path[i].y - path[i - 1].y) != 1)
+      return false;
+  }
+  return true;
+}
+
+// Every turn each agent asks for a path to the player and takes a step along it, the player
+// steps now and then and a wall is dug every few turns, which invalidates the cache.
+// Each query is also searched without the cache, paths of the cache are checked and compared
+// in length with the fresh ones, a reused suffix could be longer than a new search.
+static void run_cache(size_t size, size_t num_agents, size_t num_turns)
+{
+  BenchMap map = gen_bench_map(size, 1);
+  std::mt19937 rng(3);
+  IVec2 player = map.walkable[rng() % map.walkable.size()];
+  std::vector<IVec2> agents;
+  for (size_t i = 0; i < num_agents; ++i)
+    agents.push_back(map.walkable[rng() % map.walkable.size()]);
+
+  HierarchicalSearchContext ctx;
+  HierarchicalPath hpaPath;
+  PortalRepairContext repairCtx;
+  PathCache cache;
+  std::vector<IVec2> freshPath;
+  double freshMs = 0.0;
+  double cachedMs = 0.0;
+  size_t numInvalid = 0;
+  size_t freshTiles = 0;
+  size_t cachedTiles = 0;
+  for (size_t turn = 0; turn < num_turns; ++turn)
+  {
+    if (turn % 4 == 3)
+    {
+      const IVec2 next = map.walkable[rng() % map.walkable.size()];
+      const IVec2 step{player.x + (next.x > player.x) - (next.x < player.x), player.y};
+      if (map.dd.walkGrid.is_walkable(step.x, step.y))
+        player = step;
+    }
+    if (turn % 10 == 9)
+    {
+      // a wall next to the floor, so it opens up something, the map edge stays
+      IVec2 wall = map.walkable[rng() % map.walkable.size()];
+      while (wall.y > 1 && map.dd.tiles[coord_to_idx(wall.x, wall.y, size)] != dungeon::wall)
+        wall.y--;
+      const size_t idx = coord_to_idx(wall.x, wall.y, size);
+      if (map.dd.tiles[idx] == dungeon::wall)
+      {
+        map.dd.tiles[idx] = dungeon::floor;
+        map.dd.walkGrid.set_tile(size_t(wall.x), size_t(wall.y), dungeon::floor);
+        map.dd.revision++;
+        repair_dungeon_portals(map.dp, map.dd, {wall}, repairCtx);
+        map.regions.update(map.dd.tiles.data(), {idx});
+        map.walkable.push_back(wall);
+      }
+    }
+    for (IVec2 &agent : agents)
+    {
+      auto start = std::chrono::steady_clock::now();
+      freshPath.clear();
+      find_path_hierarchical(ctx, map.dd, map.dp, agent, player, hpaPath, freshPath, &map.regions);
+      freshMs += get_ms(start);
+      start = std::chrono::steady_clock::now();
+      const std::vector<IVec2> path = cache.get_path(agent, player, map.dd.revision, [&](IVec2 from, IVec2 to)
+      {
+        return find_path_hierarchical(ctx, map.dd, map.dp, from, to, &map.regions);
+      });
+      cachedMs += get_ms(start);
+      numInvalid += !is_valid_path(map.dd, path, agent, player);
+      freshTiles += freshPath.size();
+      cachedTiles += path.size();
+      if (path.size() > 1)
+        agent = path[1];
+    }
+  }
+  const PathCache::Stats &stats = cache.get_stats();
+  const double turns = double(num_turns);
+  printf("%zu,%zu,%zu,%.3f,%.3f,%.3f,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%.2f\n", size, num_agents, num_turns,
+         freshMs / turns, cachedMs / turns, double(cache.get_hit_rate()), stats.suffixHits, stats.evictions,
+         stats.invalidations, cache.get_num_entries(), cache.get_num_tiles(), cache.get_allocated_bytes(), numInvalid,
+         100.0 * (double(cachedTiles) / double(std::max(freshTiles, size_t(1))) - 1.0));
+}
+
+// Portal indices of a repaired graph differ from a built one, so graphs are compared
+// by the tiles of their portals: nodes of each cluster and connections of each node.
+struct PortalGraphShape
+{
+  using Bounds = std::tuple<uint16_t, uint16_t, uint16_t, uint16_t>;
+
+  std::vector<std::vector<std::tuple<size_t, Bounds>>> nodes;
+  std::vector<std::vector<std::tuple<Bounds, Bounds, float, uint32_t>>> conns;
+
+  bool operator==(const PortalGraphShape &) const = default;
+};
+
+static PortalGraphShape get_shape(const DungeonPortals &dp)
+{
+  auto get_bounds = [&](uint32_t idx)
+  {
+    const PathPortal &portal = dp.portals[idx];
+    return PortalGraphShape::Bounds{portal.startX, portal.startY, portal.endX, portal.endY};
+  };
+  PortalGraphShape res;
+  for (size_t level = 0; level < get_num_levels(dp); ++level)
+  {
+    auto &nodes = res.nodes.emplace_back();
+    auto &conns = res.conns.emplace_back();
+    for (size_t cluster = 0; cluster < dp.levels[level].clusterEnds.size(); ++cluster)
+      for (uint32_t idx : get_cluster_portals(dp, level, cluster))
+      {
+        nodes.emplace_back(cluster, get_bounds(idx));
+        for (const PortalConnection &conn : get_portal_conns(dp, level, idx))
+          conns.emplace_back(get_bounds(idx), get_bounds(conn.connIdx), conn.score, conn.clusterIdx);
+      }
+    std::sort(nodes.begin(), nodes.end());
+    std::sort(conns.begin(), conns.end());
+  }
+  return res;
+}
+
+// Random tiles are dug or walled up one by one and the graph is repaired after each,
+// every tenth repair and the last one are compared with a graph built from scratch.
+static bool run_repairs(size_t size, size_t num_edits)
+{
+  BenchMap map = gen_bench_map(size, 1);
+  std::mt19937 rng(4);
+  PortalRepairContext repairCtx;
+  std::vector<double> repairUs;
+  double fullMs = 0.0;
+  size_t numChecks = 0;
+  size_t numDifferent = 0;
+  for (size_t edit = 0; edit < num_edits; ++edit)
+  {
+    const IVec2 tile{int(1 + rng() % (size - 2)), int(1 + rng() % (size - 2))};
+    char &c = map.dd.tiles[coord_to_idx(tile.x, tile.y, size)];
+    c = c == dungeon::wall ? dungeon::floor : dungeon::wall;
+    map.dd.walkGrid.set_tile(size_t(tile.x), size_t(tile.y), c);
+    const auto start = std::chrono::steady_clock::now();
+    repair_dungeon_portals(map.dp, map.dd, {tile}, repairCtx);
+    repairUs.push_back(get_ms(start) * 1e3);
+    if (edit % 10 == 9 || edit + 1 == num_edits)
+    {
+      const auto fullStart = std::chrono::steady_clock::now();
+      const DungeonPortals built = build_dungeon_portals(map.dd, bench_cluster_sizes, 1);
+      fullMs += get_ms(fullStart);
+      numChecks++;
+      numDifferent += !(get_shape(built) == get_shape(map.dp));
+    }
+  }
+  std::vector<double> sorted = repairUs;
+  std::sort(sorted.begin(), sorted.end());
+  double totalUs = 0.0;
+  for (double us : repairUs)
+    totalUs += us;
+  printf("%zu,%zu,%.1f,%.1f,%.1f,%.1f,%.3f,%zu,%zu,%zu\n", size, num_edits, totalUs / double(num_edits),
+         sorted[sorted.size() / 2], sorted[sorted.size() * 99 / 100], sorted.back(), fullMs / double(numChecks),
+         get_allocated_bytes(map.dp), numChecks, numDifferent);
+  return numDifferent == 0;
+}
+
+int main(int argc, const char **argv)
+{
+  if (argc > 1 && strcmp(argv[1], "repair") == 0)
+  {
+    const size_t size = argc > 2 ? size_t(atoi(argv[2])) : 512;
+    const size_t numEdits = std::max(argc > 3 ? size_t(atoi(argv[3])) : 500, size_t(1));
+    printf("size,edits,avg_repair_us,p50_repair_us,p99_repair_us,max_repair_us,full_build_ms,portal_bytes,"
+           "checks,different_graphs\n");
+    return run_repairs(size, numEdits) ? 0 : 1;
+  }
+  if (argc > 1 && strcmp(argv[1], "cache") == 0)
+  {
+    const size_t numAgents = argc > 2 ? size_t(atoi(argv[2])) : 200;
+    printf("size,agents,turns,uncached_ms,cached_ms,hit_rate,suffix_hits,evictions,invalidations,"
+           "entries,tiles,cache_bytes,invalid_paths,extra_tiles_percent\n");
+    run_cache(512, numAgents, 100);
+    return 0;
+  }
+
+  const size_t numRequests = argc > 1 ? size_t(atoi(argv[1])) : 1000;
+  constexpr size_t sizes[] = {128, 512};
+
+  printf("size,requests,threads,batch_ms,speedup,found,tiles,different_paths\n");
+  for (size_t size : sizes)
+    run_batches(size, numRequests);
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "compactPath.h"
+
+static constexpr IVec2 run_dirs[4] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+static int get_run_dir(IVec2 delta)
+{
+  for (int i = 0; i < 4; ++i)
+    if (delta == run_dirs[i])
+      return i;
+  return -1;
+}
+
+bool encode_path(std::span<const IVec2> path, CompactPath &res)
+{
+  res.runs.clear();
+  res.length = 0;
+  if (path.empty())
+    return true;
+  res.from = path[0];
+  res.length = uint32_t(path.size());
+  for (size_t i = 1; i < path.size();)
+  {
+    const int dir = get_run_dir(path[i] - path[i - 1]);
+    if (dir < 0)
+    {
+      res.runs.clear();
+      res.length = 0;
+      return false;
+    }
+    uint32_t count = 1;
+    while (i + count < path.size() && count < CompactPath::max_run &&
+           path[i + count] - path[i + count - 1] == run_dirs[dir])
+      count++;
+    res.runs.push_back(uint8_t(uint32_t(dir) | (count - 1) << 2));
+    i += count;
+  }
+  return true;
+}
+
+void decode_path(const CompactPath &path, std::vector<IVec2> &res)
+{
+  if (path.length == 0)
+    return;
+  res.reserve(res.size() + path.length);
+  IVec2 pos = path.from;
+  res.push_back(pos);
+  for (uint8_t run : path.runs)
+  {
+    const IVec2 dir = run_dirs[run & 3];
+    for (uint32_t i = 0; i <= uint32_t(run >> 2); ++i)
+    {
+      pos = IVec2{pos.x + dir.x, pos.y + dir.y};
+      res.push_back(pos);
+    }
+  }
+}
+
+bool CompactPathCursor::advance(const CompactPath &path)
+{
+  if (is_finished(path))
+    return false;
+  const uint8_t cur = path.runs[run];
+  const IVec2 dir = run_dirs[cur & 3];
+  pos = IVec2{pos.x + dir.x, pos.y + dir.y};
+  if (++step > uint32_t(cur >> 2))
+  {
+    run++;
+    step = 0;
+  }
+  return true;
+}
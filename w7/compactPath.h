@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "math.h"
+
+// 4-connected path as its start tile and runs of steps in one direction, a byte per run:
+// direction in the low two bits, run length - 1 in the upper six, longer runs are split.
+// Paths over the dungeon are mostly straight corridors, so it's a fraction of a byte per tile
+// instead of the 8 bytes of an IVec2, agents could keep whole paths for a long time.
+struct CompactPath
+{
+  static constexpr uint32_t max_run = 64;
+
+  IVec2 from{0, 0};
+  uint32_t length = 0; // in tiles, start included, 0 for an empty path
+  std::vector<uint8_t> runs;
+};
+
+// false if the tiles aren't a 4-connected path, res is empty then
+bool encode_path(std::span<const IVec2> path, CompactPath &res);
+// appends all tiles of the path to res
+void decode_path(const CompactPath &path, std::vector<IVec2> &res);
+
+// Walks the path tile by tile without decoding it.
+struct CompactPathCursor
+{
+  IVec2 pos{0, 0};
+  size_t run = 0;
+  uint32_t step = 0; // steps already taken in the current run
+
+  CompactPathCursor() = default;
+  explicit CompactPathCursor(const CompactPath &path) : pos(path.from) {}
+
+  bool is_finished(const CompactPath &path) const { return run >= path.runs.size(); }
+  // moves to the next tile, false if we're at the end already
+  bool advance(const CompactPath &path);
+};
@@ -11,9 +11,9 @@ Position dungeon::find_walkable_tile(flecs::world &ecs)
     // prebuild all walkable and get one of them
     std::vector<Position> posList;
     for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-        if (dd.tiles[y * dd.width + x] == dungeon::floor)
-          posList.push_back(Position{float(x), float(y)});
+      for (size_t x = dd.walkGrid.find_walkable_in_row(y, 0); x < dd.width;
+           x = dd.walkGrid.find_walkable_in_row(y, x + 1))
+        posList.push_back(Position{float(x), float(y)});
     size_t rndIdx = size_t(GetRandomValue(0, int(posList.size()) - 1));
     res = posList[rndIdx];
   });
@@ -30,7 +30,7 @@ bool dungeon::is_tile_walkable(flecs::world &ecs, Position pos)
     if (pos.x < 0 || pos.x >= int(dd.width) ||
         pos.y < 0 || pos.y >= int(dd.height))
       return;
-    res = dd.tiles[size_t(pos.y) * dd.width + size_t(pos.x)] == dungeon::floor;
+    res = dd.walkGrid.is_walkable(int(pos.x), int(pos.y));
   });
   return res;
 }
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include "walkGrid.h"
 #include <math.h>
 
 // TODO: make a lot of seprate files
@@ -163,6 +164,8 @@ struct DungeonData
   std::vector<char> tiles; // for pathfinding
   size_t width;
   size_t height;
+  WalkGrid walkGrid; // derived from tiles, should be updated together with them
+  uint32_t revision = 0; // bumped on every change of tiles, paths found on other revisions are stale
 };
 
 struct DijkstraMapData
@@ -0,0 +1,85 @@
+#include "flowField.h"
+#include "dungeonUtils.h"
+
+void build_flow_field(FlowField &ff, const DungeonData &dd, IVec2 target)
+{
+  ff.target = target;
+  ff.width = dd.width;
+  ff.height = dd.height;
+  ff.integration.assign(dd.width * dd.height, FlowField::unreachable);
+  ff.directions.assign(dd.width * dd.height, Position{0.f, 0.f});
+  if (target.x < 0 || target.y < 0 || target.x >= int(dd.width) || target.y >= int(dd.height))
+    return;
+  const size_t targetIdx = size_t(target.y) * dd.width + size_t(target.x);
+  if (!dd.walkGrid.is_walkable(target.x, target.y))
+    return;
+
+  // integration field, unit costs so BFS is enough
+  std::vector<size_t> queue = {targetIdx};
+  ff.integration[targetIdx] = 0;
+  for (size_t head = 0; head < queue.size(); ++head)
+  {
+    const size_t cur = queue[head];
+    const size_t x = cur % dd.width;
+    const size_t y = cur / dd.width;
+    // out of the map isn't walkable, unsigned wrap takes care of negative coords
+    auto checkNeighbour = [&](size_t nx, size_t ny)
+    {
+      const size_t idx = ny * dd.width + nx;
+      if (!dd.walkGrid.is_walkable(int(nx), int(ny)) || ff.integration[idx] != FlowField::unreachable)
+        return;
+      ff.integration[idx] = ff.integration[cur] + 1;
+      queue.push_back(idx);
+    };
+    checkNeighbour(x - 1, y);
+    checkNeighbour(x + 1, y);
+    checkNeighbour(x, y - 1);
+    checkNeighbour(x, y + 1);
+  }
+
+  // point to the neighbour closest to the target, diagonals only if they don't cut a corner
+  auto integrationAt = [&](int x, int y)
+  {
+    if (x < 0 || y < 0 || x >= int(dd.width) || y >= int(dd.height))
+      return FlowField::unreachable;
+    return ff.integration[size_t(y) * dd.width + size_t(x)];
+  };
+  constexpr IVec2 dirs[8] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+  for (size_t idx : queue)
+  {
+    const int x = int(idx % dd.width);
+    const int y = int(idx / dd.width);
+    uint32_t best = ff.integration[idx];
+    IVec2 bestDir{0, 0};
+    for (const IVec2 &dir : dirs)
+    {
+      const uint32_t dist = integrationAt(x + dir.x, y + dir.y);
+      if (dist >= best)
+        continue;
+      if (dir.x != 0 && dir.y != 0 &&
+          (integrationAt(x + dir.x, y) == FlowField::unreachable ||
+           integrationAt(x, y + dir.y) == FlowField::unreachable))
+        continue;
+      best = dist;
+      bestDir = dir;
+    }
+    ff.directions[idx] = normalize(Position{float(bestDir.x), float(bestDir.y)});
+  }
+}
+
+IVec2 get_flow_field_tile(const FlowField &ff, Position world_pos)
+{
+  return IVec2{int(floorf(world_pos.x / ff.tileSize + 0.5f)), int(floorf(world_pos.y / ff.tileSize + 0.5f))};
+}
+
+bool sample_flow_field(const FlowField &ff, Position world_pos, Position &dir)
+{
+  const IVec2 tile = get_flow_field_tile(ff, world_pos);
+  if (tile.x < 0 || tile.y < 0 || tile.x >= int(ff.width) || tile.y >= int(ff.height))
+    return false;
+  const size_t idx = size_t(tile.y) * ff.width + size_t(tile.x);
+  if (ff.integration[idx] == FlowField::unreachable)
+    return false;
+  dir = ff.directions[idx];
+  return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ecsTypes.h"
+#include "math.h"
+
+// Directions towards a single target for the whole map, every agent just reads its tile.
+// Lives on the dungeon entity, rebuilt when the target changes tile.
+struct FlowField
+{
+  static constexpr uint32_t unreachable = 0xffffffff;
+
+  float tileSize = 1.f;
+  IVec2 target{-1, -1};
+  size_t width = 0;
+  size_t height = 0;
+  // distance to the target in tiles
+  std::vector<uint32_t> integration;
+  // normalized, zero on the target tile and on unreachable tiles
+  std::vector<Position> directions;
+};
+
+void build_flow_field(FlowField &ff, const DungeonData &dd, IVec2 target);
+
+// tile of the world position, tile positions are their top left corners
+IVec2 get_flow_field_tile(const FlowField &ff, Position world_pos);
+
+// Returns false if the tile is outside of the field or can't reach the target.
+bool sample_flow_field(const FlowField &ff, Position world_pos, Position &dir);
@@ -0,0 +1,313 @@
+#include "hpaPathfinder.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <limits>
+
+static size_t get_cluster(const DungeonData &dd, const DungeonPortals &dp, size_t level, IVec2 p)
+{
+  const size_t split = get_level_split(dp, level);
+  return size_t(p.y) / split * get_clusters_width(dd, split) + size_t(p.x) / split;
+}
+
+// closest (by flood distance) tile of the portal part which lies inside of the limits
+static float get_closest_portal_tile(const AStarContext &ctx, const DungeonData &dd, const PathPortal &portal,
+                                     IVec2 lim_min, IVec2 lim_max, IVec2 &res)
+{
+  float minDist = std::numeric_limits<float>::max();
+  for (int y = std::max(int(portal.startY), lim_min.y); y <= std::min(int(portal.endY), lim_max.y - 1); ++y)
+    for (int x = std::max(int(portal.startX), lim_min.x); x <= std::min(int(portal.endX), lim_max.x - 1); ++x)
+    {
+      const float dist = ctx.get_g(uint32_t(coord_to_idx(x, y, dd.width)));
+      if (dist < minDist)
+      {
+        minDist = dist;
+        res = IVec2{x, y};
+      }
+    }
+  return minDist;
+}
+
+// portal tile on the other side of the cluster border
+static IVec2 cross_portal(const PathPortal &portal, IVec2 p, IVec2 lim_min, IVec2 lim_max)
+{
+  if (p.x == lim_min.x && int(portal.startX) < lim_min.x)
+    return IVec2{p.x - 1, p.y};
+  if (p.x == lim_max.x - 1 && int(portal.endX) >= lim_max.x)
+    return IVec2{p.x + 1, p.y};
+  if (p.y == lim_min.y && int(portal.startY) < lim_min.y)
+    return IVec2{p.x, p.y - 1};
+  return IVec2{p.x, p.y + 1};
+}
+
+static IVec2 get_portal_center(const PathPortal &portal)
+{
+  return IVec2{(portal.startX + portal.endX) / 2, (portal.startY + portal.endY) / 2};
+}
+
+static bool is_walkable(const DungeonData &dd, IVec2 p)
+{
+  return dd.walkGrid.is_walkable(p.x, p.y);
+}
+
+// distances from the tile to all portals of its cluster
+static void connect_to_cluster(HierarchicalSearchContext &ctx, const DungeonData &dd, const DungeonPortals &dp,
+                               IVec2 pos, size_t cluster, float crossing_cost, std::vector<PortalConnection> &conns)
+{
+  conns.clear();
+  IVec2 limMin, limMax;
+  get_cluster_limits(dd, get_level_split(dp, 0), cluster, limMin, limMax);
+  flood_area(ctx.tileCtx, dd, pos, limMin, limMax);
+  IVec2 closest;
+  for (uint32_t portalIdx : get_cluster_portals(dp, 0, cluster))
+  {
+    const float dist = get_closest_portal_tile(ctx.tileCtx, dd, dp.portals[portalIdx], limMin, limMax, closest);
+    if (dist < std::numeric_limits<float>::max())
+      conns.push_back({portalIdx, dist + crossing_cost, uint32_t(cluster)});
+  }
+}
+
+// A* over the portal graph, start and goal are two extra nodes after the portals connected with
+// ctx.startConns and ctx.goalConns. Connections of levels [min_level, max_level] are used if
+// use_conn(level, conn) allows it, the level each node is entered through goes to ctx.arrivalLevel.
+template<typename Callable>
+static void search_portal_graph(HierarchicalSearchContext &ctx, const DungeonPortals &dp,
+                                size_t min_level, size_t max_level, uint32_t from_node, uint32_t to_node,
+                                IVec2 to_pos, Callable use_conn)
+{
+  const uint32_t startNode = uint32_t(dp.portals.size());
+  const uint32_t goalNode = startNode + 1;
+  AStarContext &pctx = ctx.portalCtx;
+  pctx.begin_query(dp.portals.size() + 2, 1);
+  ctx.arrivalCluster.resize(dp.portals.size() + 2);
+  ctx.arrivalLevel.resize(dp.portals.size() + 2);
+  pctx.push(from_node, 0.f, 0.f, AStarContext::invalid_idx);
+  while (!pctx.empty())
+  {
+    const uint32_t cur = pctx.pop();
+    if (cur == to_node)
+      break;
+    pctx.close(cur);
+    pctx.numExpanded++;
+    const float curG = pctx.get_g(cur);
+    auto relax = [&](const PortalConnection &conn, uint32_t node, size_t level)
+    {
+      if (pctx.is_closed(node))
+        return;
+      const float gScore = curG + conn.score;
+      if (gScore >= pctx.get_g(node))
+        return;
+      const float h = node == goalNode ? 0.f : heuristic(get_portal_center(dp.portals[node]), to_pos);
+      pctx.push(node, gScore, gScore + h, cur);
+      ctx.arrivalCluster[node] = conn.clusterIdx;
+      ctx.arrivalLevel[node] = level;
+    };
+    if (cur == startNode)
+    {
+      for (const PortalConnection &conn : ctx.startConns)
+        relax(conn, conn.connIdx, 0);
+      continue;
+    }
+    for (size_t level = min_level; level <= max_level; ++level)
+      for (const PortalConnection &conn : get_portal_conns(dp, level, cur))
+        if (use_conn(level, conn))
+          relax(conn, conn.connIdx, level);
+    if (to_node == goalNode)
+      for (const PortalConnection &conn : ctx.goalConns)
+        if (conn.connIdx == cur)
+          relax(conn, goalNode, 0);
+  }
+}
+
+// appends nodes of the found route after from_node, with clusters and levels they're entered through
+static void append_route(HierarchicalSearchContext &ctx, uint32_t from_node, uint32_t to_node,
+                         std::vector<uint32_t> &nodes, std::vector<size_t> &clusters, std::vector<size_t> &levels)
+{
+  const size_t first = nodes.size();
+  for (uint32_t node = to_node; node != from_node; node = ctx.portalCtx.get_prev(node))
+  {
+    nodes.push_back(node);
+    clusters.push_back(ctx.arrivalCluster[node]);
+    levels.push_back(ctx.arrivalLevel[node]);
+  }
+  std::reverse(nodes.begin() + std::ptrdiff_t(first), nodes.end());
+  std::reverse(clusters.begin() + std::ptrdiff_t(first), clusters.end());
+  std::reverse(levels.begin() + std::ptrdiff_t(first), levels.end());
+}
+
+bool find_hierarchical_path(HierarchicalSearchContext &ctx, const DungeonData &dd, const DungeonPortals &dp,
+                            IVec2 from, IVec2 to, HierarchicalPath &path, const MapRegions *regions)
+{
+  // cleared rather than reassigned, so a path reused between queries keeps its buffers
+  path.portals.clear();
+  path.clusters.clear();
+  path.cost = 0.f;
+  path.nextSegment = 0;
+  path.from = from;
+  path.to = to;
+  path.curPos = from;
+  ctx.localTiles.clear();
+  ctx.numExpanded = 0;
+  ctx.numRefineExpanded = 0;
+  if (!is_walkable(dd, from) || !is_walkable(dd, to))
+    return false;
+  if (regions && !regions->is_reachable(coord_to_idx(from.x, from.y, dd.width), coord_to_idx(to.x, to.y, dd.width)))
+    return false;
+
+  const size_t fromCluster = get_cluster(dd, dp, 0, from);
+  const size_t toCluster = get_cluster(dd, dp, 0, to);
+  if (fromCluster == toCluster)
+  {
+    IVec2 limMin, limMax;
+    get_cluster_limits(dd, get_level_split(dp, 0), fromCluster, limMin, limMax);
+    if (find_path_a_star(ctx.tileCtx, dd, from, to, limMin, limMax, ctx.localTiles))
+    {
+      path.clusters.push_back(fromCluster);
+      path.cost = float(ctx.localTiles.size() - 1);
+      return true;
+    }
+  }
+
+  // temporarily insert start and goal into the portal graph
+  connect_to_cluster(ctx, dd, dp, from, fromCluster, 1.f, ctx.startConns);
+  connect_to_cluster(ctx, dd, dp, to, toCluster, 0.f, ctx.goalConns);
+  if (ctx.startConns.empty() || ctx.goalConns.empty())
+    return false;
+
+  // Every cluster is crossed by connections of the coarsest level where it contains neither start
+  // nor goal, so they only need connections of the base level. Far from them the search takes
+  // big steps over coarse clusters, close to them it goes down to the base clusters.
+  const size_t numLevels = get_num_levels(dp);
+  auto has_ends = [&](size_t level, size_t cluster)
+  {
+    return cluster == get_cluster(dd, dp, level, from) || cluster == get_cluster(dd, dp, level, to);
+  };
+  auto use_conn = [&](size_t level, const PortalConnection &conn)
+  {
+    if (level > 0 && has_ends(level, conn.clusterIdx))
+      return false;
+    return level + 1 == numLevels || has_ends(level + 1, get_parent_cluster(dd, dp, level, conn.clusterIdx));
+  };
+  const uint32_t startNode = uint32_t(dp.portals.size());
+  const uint32_t goalNode = startNode + 1;
+  search_portal_graph(ctx, dp, 0, numLevels - 1, startNode, goalNode, to, use_conn);
+  ctx.numExpanded = ctx.portalCtx.numExpanded;
+  if (!ctx.portalCtx.is_visited(goalNode))
+    return false;
+  path.cost = ctx.portalCtx.get_g(goalNode);
+  std::vector<uint32_t> &nodes = ctx.refinedNodes;
+  std::vector<size_t> &clusters = ctx.refinedClusters;
+  std::vector<size_t> &levels = ctx.refinedLevels;
+  nodes.clear();
+  clusters.clear();
+  levels.clear();
+  append_route(ctx, startNode, goalNode, nodes, clusters, levels);
+
+  // coarse connections are paths over the level below inside of their cluster, refined top down
+  for (size_t level = numLevels - 1; level > 0; --level)
+  {
+    ctx.routeNodes.swap(nodes);
+    ctx.routeClusters.swap(clusters);
+    ctx.routeLevels.swap(levels);
+    nodes.clear();
+    clusters.clear();
+    levels.clear();
+    uint32_t prevNode = startNode;
+    for (size_t i = 0; i < ctx.routeNodes.size(); ++i)
+    {
+      const uint32_t node = ctx.routeNodes[i];
+      const size_t cluster = ctx.routeClusters[i];
+      if (ctx.routeLevels[i] != level)
+      {
+        nodes.push_back(node);
+        clusters.push_back(cluster);
+        levels.push_back(ctx.routeLevels[i]);
+        prevNode = node;
+        continue;
+      }
+      search_portal_graph(ctx, dp, level - 1, level - 1, prevNode, node, get_portal_center(dp.portals[node]),
+                          [&](size_t, const PortalConnection &conn)
+                          {
+                            return get_parent_cluster(dd, dp, level - 1, conn.clusterIdx) == cluster;
+                          });
+      ctx.numRefineExpanded += ctx.portalCtx.numExpanded;
+      if (!ctx.portalCtx.is_visited(node))
+        return false;
+      append_route(ctx, prevNode, node, nodes, clusters, levels);
+      prevNode = node;
+    }
+  }
+  path.portals.assign(nodes.begin(), nodes.end() - 1);
+  path.clusters.assign(clusters.begin(), clusters.end());
+  return true;
+}
+
+bool refine_next_segment(HierarchicalSearchContext &ctx, const DungeonData &dd, const DungeonPortals &dp,
+                         HierarchicalPath &path, std::vector<IVec2> &res)
+{
+  if (path.nextSegment >= path.clusters.size())
+    return false;
+  IVec2 limMin, limMax;
+  get_cluster_limits(dd, get_level_split(dp, 0), path.clusters[path.nextSegment], limMin, limMax);
+  if (path.nextSegment == path.portals.size())
+  {
+    // last segment, straight to the goal
+    const size_t first = res.size();
+    if (!find_path_a_star(ctx.tileCtx, dd, path.curPos, path.to, limMin, limMax, res))
+      return false;
+    // we're already standing on the first tile
+    res.erase(res.begin() + std::ptrdiff_t(first));
+    path.curPos = path.to;
+    path.nextSegment++;
+    return true;
+  }
+  const PathPortal &portal = dp.portals[path.portals[path.nextSegment]];
+  flood_area(ctx.tileCtx, dd, path.curPos, limMin, limMax);
+  IVec2 portalTile;
+  if (get_closest_portal_tile(ctx.tileCtx, dd, portal, limMin, limMax, portalTile) == std::numeric_limits<float>::max())
+    return false;
+  append_path(ctx.tileCtx, portalTile, dd.width, res, false);
+  path.curPos = portalTile;
+  path.nextSegment++;
+  // next segment could continue in the same cluster, cross only if it doesn't
+  if (path.clusters[path.nextSegment] != path.clusters[path.nextSegment - 1])
+  {
+    path.curPos = cross_portal(portal, portalTile, limMin, limMax);
+    res.push_back(path.curPos);
+  }
+  return true;
+}
+
+bool find_path_hierarchical(HierarchicalSearchContext &ctx, const DungeonData &dd, const DungeonPortals &dp,
+                            IVec2 from, IVec2 to, HierarchicalPath &path, std::vector<IVec2> &res,
+                            const MapRegions *regions)
+{
+  if (!find_hierarchical_path(ctx, dd, dp, from, to, path, regions))
+    return false;
+  // start and goal were connected inside of their cluster, the local search has the whole path
+  if (!ctx.localTiles.empty())
+  {
+    res.insert(res.end(), ctx.localTiles.begin(), ctx.localTiles.end());
+    path.curPos = to;
+    path.nextSegment = path.clusters.size();
+    return true;
+  }
+  const size_t first = res.size();
+  res.push_back(from);
+  while (refine_next_segment(ctx, dd, dp, path, res));
+  if (path.nextSegment < path.clusters.size())
+  {
+    res.resize(first);
+    return false;
+  }
+  return true;
+}
+
+std::vector<IVec2> find_path_hierarchical(HierarchicalSearchContext &ctx, const DungeonData &dd,
+                                          const DungeonPortals &dp, IVec2 from, IVec2 to,
+                                          const MapRegions *regions)
+{
+  HierarchicalPath path;
+  std::vector<IVec2> res;
+  find_path_hierarchical(ctx, dd, dp, from, to, path, res, regions);
+  return res;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include "ecsTypes.h"
+#include "math.h"
+#include "aStarContext.h"
+#include "pathfinder.h"
+
+// Route over the portal graph. Segment i goes through cluster clusters[i] and ends at
+// portals[i] (the last one ends at the goal), tiles are produced segment by segment.
+struct HierarchicalPath
+{
+  IVec2 from;
+  IVec2 to;
+  std::vector<size_t> portals;
+  std::vector<size_t> clusters;
+  float cost = 0.f;
+
+  // refinement state
+  size_t nextSegment = 0;
+  IVec2 curPos;
+};
+
+struct HierarchicalSearchContext
+{
+  AStarContext tileCtx;
+  AStarContext portalCtx;
+  // temporary edges of start and goal nodes
+  std::vector<PortalConnection> startConns;
+  std::vector<PortalConnection> goalConns;
+  std::vector<size_t> arrivalCluster;
+  std::vector<size_t> arrivalLevel;
+  // route which is being refined, nodes with clusters and levels they're entered through
+  std::vector<uint32_t> routeNodes;
+  std::vector<size_t> routeClusters;
+  std::vector<size_t> routeLevels;
+  // route of the next level down while it's being refined, and tiles of the local search
+  std::vector<uint32_t> refinedNodes;
+  std::vector<size_t> refinedClusters;
+  std::vector<size_t> refinedLevels;
+  std::vector<IVec2> localTiles;
+
+  // stats of the last query, portals expanded by the search and by refinement of coarse connections
+  size_t numExpanded = 0;
+  size_t numRefineExpanded = 0;
+};
+
+// Returns false if there's no path. Start and goal are temporarily connected to the portals
+// of their clusters, then A* runs over the portal graph only. Clusters which contain neither
+// of them are crossed in one step over the coarsest level possible, then these steps are
+// refined level by level inside of their clusters, down to the base portals.
+// With regions disconnected start and goal are rejected before any search.
+// A path inside of one cluster is found directly, its tiles are left in ctx.localTiles.
+bool find_hierarchical_path(HierarchicalSearchContext &ctx, const DungeonData &dd, const DungeonPortals &dp,
+                            IVec2 from, IVec2 to, HierarchicalPath &path, const MapRegions *regions = nullptr);
+
+// Appends tiles of the next segment to res (without the tile we're already standing on).
+// Returns false when the path is fully refined or refinement failed.
+bool refine_next_segment(HierarchicalSearchContext &ctx, const DungeonData &dd, const DungeonPortals &dp,
+                         HierarchicalPath &path, std::vector<IVec2> &res);
+
+// Full tile path, appended to res, false if there's none. With ctx and path reused between queries
+// nothing is allocated once their buffers have grown, res is the only output.
+bool find_path_hierarchical(HierarchicalSearchContext &ctx, const DungeonData &dd, const DungeonPortals &dp,
+                            IVec2 from, IVec2 to, HierarchicalPath &path, std::vector<IVec2> &res,
+                            const MapRegions *regions = nullptr);
+// Full tile path, empty if there's none.
+std::vector<IVec2> find_path_hierarchical(HierarchicalSearchContext &ctx, const DungeonData &dd,
+                                          const DungeonPortals &dp, IVec2 from, IVec2 to,
+                                          const MapRegions *regions = nullptr);
+
@@ -1,6 +1,7 @@
 #include "raylib.h"
 #include <flecs.h>
 #include <algorithm>
+#include <cstring>
 
 #include "ecsTypes.h"
 #include "shootEmUp.h"
@@ -22,8 +23,14 @@ static void update_camera(flecs::world &ecs)
 }
 
 
-int main(int /*argc*/, const char ** /*argv*/)
+int main(int argc, const char **argv)
 {
+  // --nav-cache <dir> keeps navigation data of the map between runs
+  const char *navCacheDir = nullptr;
+  for (int i = 1; i + 1 < argc; ++i)
+    if (strcmp(argv[i], "--nav-cache") == 0)
+      navCacheDir = argv[i + 1];
+
   int width = 1920;
   int height = 1080;
   InitWindow(width, height, "w6 AI MIPT");
@@ -43,7 +50,7 @@ int main(int /*argc*/, const char ** /*argv*/)
     constexpr size_t dungHeight = 50;
     char *tiles = new char[dungWidth * dungHeight];
     gen_drunk_dungeon(tiles, dungWidth, dungHeight);
-    init_dungeon(ecs, tiles, dungWidth, dungHeight);
+    init_dungeon(ecs, tiles, dungWidth, dungHeight, navCacheDir);
   }
   init_shoot_em_up(ecs);
 
@@ -0,0 +1,225 @@
+#include "mapRegions.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+
+// neighbours which currently have a region, during update tiles could be ahead of labels
+template<typename Callable>
+static void for_each_labeled_neighbour(const std::vector<uint32_t> &labels, size_t width, size_t height,
+                                       size_t idx, Callable c)
+{
+  const size_t x = idx % width;
+  const size_t y = idx / width;
+  if (x > 0 && labels[idx - 1] != MapRegions::no_region)
+    c(idx - 1);
+  if (x + 1 < width && labels[idx + 1] != MapRegions::no_region)
+    c(idx + 1);
+  if (y > 0 && labels[idx - width] != MapRegions::no_region)
+    c(idx - width);
+  if (y + 1 < height && labels[idx + width] != MapRegions::no_region)
+    c(idx + width);
+}
+
+void MapRegions::build(const char *tiles, size_t w, size_t h)
+{
+  width = w;
+  height = h;
+  labels.assign(w * h, no_region);
+  parent.clear();
+  visitStamp.assign(w * h, 0);
+  stamp = 0;
+
+  std::vector<size_t> queue;
+  for (size_t i = 0; i < labels.size(); ++i)
+  {
+    if (tiles[i] == dungeon::wall || labels[i] != no_region)
+      continue;
+    const uint32_t label = new_label();
+    labels[i] = label;
+    queue.clear();
+    queue.push_back(i);
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+      const size_t cur = queue[head];
+      const size_t x = cur % w;
+      const size_t y = cur / w;
+      auto checkNeighbour = [&](size_t idx)
+      {
+        if (tiles[idx] == dungeon::wall || labels[idx] != no_region)
+          return;
+        labels[idx] = label;
+        queue.push_back(idx);
+      };
+      if (x > 0)
+        checkNeighbour(cur - 1);
+      if (x + 1 < w)
+        checkNeighbour(cur + 1);
+      if (y > 0)
+        checkNeighbour(cur - w);
+      if (y + 1 < h)
+        checkNeighbour(cur + w);
+    }
+  }
+}
+
+void MapRegions::assign(const uint32_t *region_labels, size_t w, size_t h)
+{
+  width = w;
+  height = h;
+  labels.assign(region_labels, region_labels + w * h);
+  uint32_t numLabels = 0;
+  for (uint32_t label : labels)
+    if (label != no_region)
+      numLabels = std::max(numLabels, label + 1);
+  parent.resize(numLabels);
+  for (uint32_t i = 0; i < numLabels; ++i)
+    parent[i] = i;
+  visitStamp.assign(w * h, 0);
+  stamp = 0;
+}
+
+void MapRegions::update(const char *tiles, const std::vector<size_t> &changed_tiles)
+{
+  for (size_t idx : changed_tiles)
+  {
+    const bool wasWalkable = labels[idx] != no_region;
+    const bool isWalkable = tiles[idx] != dungeon::wall;
+    if (!wasWalkable && isWalkable)
+      add_tile(idx);
+    else if (wasWalkable && !isWalkable)
+      remove_tile(idx);
+  }
+  // every edit could produce new labels, compact them once in a while
+  if (parent.size() > 2 * labels.size() + 64)
+    build(tiles, width, height);
+}
+
+// path halving, parents which already point to the root aren't written
+uint32_t MapRegions::find_root(uint32_t label) const
+{
+  while (parent[label] != label)
+  {
+    const uint32_t grandParent = parent[parent[label]];
+    if (grandParent != parent[label])
+      parent[label] = grandParent;
+    label = grandParent;
+  }
+  return label;
+}
+
+void MapRegions::flatten() const
+{
+  for (uint32_t label = 0; label < parent.size(); ++label)
+    parent[label] = find_root(label);
+}
+
+uint32_t MapRegions::new_label()
+{
+  const uint32_t label = uint32_t(parent.size());
+  parent.push_back(label);
+  return label;
+}
+
+void MapRegions::add_tile(size_t idx)
+{
+  uint32_t root = no_region;
+  for_each_labeled_neighbour(labels, width, height, idx, [&](size_t nidx)
+  {
+    const uint32_t nroot = find_root(labels[nidx]);
+    if (root == no_region)
+      root = nroot;
+    else if (nroot != root)
+      parent[nroot] = root;
+  });
+  labels[idx] = root == no_region ? new_label() : root;
+}
+
+// Floods from every neighbour of the removed tile in lockstep. Floods which meet are
+// merged, a group of floods which runs out of tiles while others are still going is
+// a separated part and gets a new label. So the work is bounded by the smaller part.
+void MapRegions::remove_tile(size_t idx)
+{
+  labels[idx] = no_region;
+  size_t neighbours[4];
+  size_t count = 0;
+  for_each_labeled_neighbour(labels, width, height, idx, [&](size_t nidx) { neighbours[count++] = nidx; });
+  if (count < 2)
+    return;
+
+  if (stamp > 0xffffffff - 8)
+  {
+    std::fill(visitStamp.begin(), visitStamp.end(), 0);
+    stamp = 0;
+  }
+  const uint32_t base = stamp + 1;
+  stamp += uint32_t(count);
+
+  size_t group[4];
+  size_t heads[4];
+  bool separated[4] = {false, false, false, false};
+  for (size_t s = 0; s < count; ++s)
+  {
+    group[s] = s;
+    heads[s] = 0;
+    splitQueues[s].clear();
+    splitQueues[s].push_back(neighbours[s]);
+    visitStamp[neighbours[s]] = base + uint32_t(s);
+  }
+  auto find_group = [&](size_t s)
+  {
+    while (group[s] != s)
+      s = group[s];
+    return s;
+  };
+  auto count_groups = [&]()
+  {
+    size_t res = 0;
+    for (size_t s = 0; s < count; ++s)
+      if (!separated[s] && find_group(s) == s)
+        res++;
+    return res;
+  };
+
+  while (count_groups() > 1)
+  {
+    for (size_t s = 0; s < count; ++s)
+    {
+      if (separated[s] || heads[s] == splitQueues[s].size())
+        continue;
+      const size_t cur = splitQueues[s][heads[s]++];
+      for_each_labeled_neighbour(labels, width, height, cur, [&](size_t nidx)
+      {
+        const uint32_t st = visitStamp[nidx];
+        if (st >= base && st < base + count)
+        {
+          const size_t a = find_group(s);
+          const size_t b = find_group(st - base);
+          if (a != b)
+            group[b] = a;
+          return;
+        }
+        visitStamp[nidx] = base + uint32_t(s);
+        splitQueues[s].push_back(nidx);
+      });
+    }
+    for (size_t g = 0; g < count && count_groups() > 1; ++g)
+    {
+      if (separated[g] || find_group(g) != g)
+        continue;
+      bool exhausted = true;
+      for (size_t s = 0; s < count; ++s)
+        if (find_group(s) == g && heads[s] < splitQueues[s].size())
+          exhausted = false;
+      if (!exhausted)
+        continue;
+      const uint32_t label = new_label();
+      for (size_t s = 0; s < count; ++s)
+        if (find_group(s) == g)
+        {
+          for (size_t tile : splitQueues[s])
+            labels[tile] = label;
+          separated[s] = true;
+        }
+    }
+  }
+}
+
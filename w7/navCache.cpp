@@ -0,0 +1,339 @@
+#include "navCache.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr char nav_cache_magic[8] = {'N', 'A', 'V', 'C', 'A', 'C', 'H', 'E'};
+static constexpr size_t section_alignment = 64;
+// sections are the in-memory arrays, these must not change without bumping the version
+static_assert(sizeof(PathPortal) == 8 && sizeof(PortalConnection) == 12);
+
+// FNV-1a
+uint64_t hash_tiles(const char *tiles, size_t count)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < count; ++i)
+  {
+    hash ^= uint8_t(tiles[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Sections are appended to one buffer, header and section table go in front of it.
+class NavCache::Writer
+{
+public:
+  template<typename T>
+  void add(SectionKind kind, uint32_t level, const T *values, size_t count)
+  {
+    payload.resize((payload.size() + section_alignment - 1) / section_alignment * section_alignment);
+    sections.push_back({kind, level, payload.size(), count});
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(values);
+    payload.insert(payload.end(), bytes, bytes + count * sizeof(T));
+  }
+  template<typename T>
+  void add(SectionKind kind, uint32_t level, const std::vector<T> &values)
+  {
+    add(kind, level, values.data(), values.size());
+  }
+
+  bool write(const char *path, const DungeonData &dd)
+  {
+    Header header;
+    memcpy(header.magic, nav_cache_magic, sizeof(header.magic));
+    header.version = NavCache::version;
+    header.numSections = uint32_t(sections.size());
+    header.tilesHash = hash_tiles(dd.tiles.data(), dd.tiles.size());
+    header.width = dd.width;
+    header.height = dd.height;
+    const size_t tableSize = sizeof(Header) + sections.size() * sizeof(Section);
+    const size_t payloadOffset = (tableSize + section_alignment - 1) / section_alignment * section_alignment;
+    for (Section &section : sections)
+      section.offset += payloadOffset;
+
+    // written next to the target and renamed, so a reader never sees a partial file
+    const std::string tmpPath = std::string(path) + ".tmp";
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (!f)
+      return false;
+    const std::vector<uint8_t> padding(payloadOffset - tableSize, 0);
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(sections.data(), sizeof(Section), sections.size(), f) == sections.size();
+    ok = ok && fwrite(padding.data(), 1, padding.size(), f) == padding.size();
+    ok = ok && fwrite(payload.data(), 1, payload.size(), f) == payload.size();
+    ok = fclose(f) == 0 && ok;
+    std::error_code ec;
+    if (ok)
+      std::filesystem::rename(tmpPath, path, ec);
+    if (!ok || ec)
+    {
+      std::filesystem::remove(tmpPath, ec);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  std::vector<Section> sections;
+  std::vector<uint8_t> payload;
+};
+
+bool NavCache::open(const char *path)
+{
+  close();
+#ifdef _WIN32
+  file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    file = nullptr;
+    return false;
+  }
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < LONGLONG(sizeof(Header)))
+  {
+    close();
+    return false;
+  }
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (!view)
+  {
+    close();
+    return false;
+  }
+  data = static_cast<const uint8_t *>(view);
+  size = size_t(fileSize.QuadPart);
+#else
+  const int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header))
+  {
+    ::close(fd);
+    return false;
+  }
+  void *view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file alive
+  ::close(fd);
+  if (view == MAP_FAILED)
+    return false;
+  data = static_cast<const uint8_t *>(view);
+  size = size_t(st.st_size);
+#endif
+
+  const Header &header = get_header();
+  const size_t tableEnd = sizeof(Header) + size_t(header.numSections) * sizeof(Section);
+  if (memcmp(header.magic, nav_cache_magic, sizeof(header.magic)) != 0 || header.version != version ||
+      header.numSections > size / sizeof(Section) || tableEnd > size)
+  {
+    close();
+    return false;
+  }
+
+  // everything the loaders index with is checked once here
+  const size_t numTiles = header.width * header.height;
+  std::span<const uint64_t> splits = get_section<uint64_t>(SectionKind::LevelSplits);
+  std::span<const PathPortal> portals = get_section<PathPortal>(SectionKind::Portals);
+  bool ok = get_tiles().size() == numTiles && get_region_labels().size() == numTiles && !splits.empty();
+  for (uint64_t split : splits)
+    ok = ok && split > 0;
+  for (uint32_t label : get_region_labels())
+    ok = ok && (label < numTiles || label == MapRegions::no_region);
+  for (uint32_t idx : get_section<uint32_t>(SectionKind::FreePortals))
+    ok = ok && idx < portals.size();
+  for (uint32_t level = 0; ok && level < splits.size(); ++level)
+  {
+    std::span<const uint32_t> clusterOffsets = get_section<uint32_t>(SectionKind::ClusterOffsets, level);
+    std::span<const uint32_t> clusterPortals = get_section<uint32_t>(SectionKind::ClusterPortals, level);
+    std::span<const uint32_t> connOffsets = get_section<uint32_t>(SectionKind::ConnOffsets, level);
+    std::span<const PortalConnection> conns = get_section<PortalConnection>(SectionKind::Conns, level);
+    const size_t split = splits[level];
+    const size_t numClusters = (header.width + split - 1) / split * ((header.height + split - 1) / split);
+    ok = clusterOffsets.size() == numClusters + 1 && connOffsets.size() == portals.size() + 1 &&
+         clusterOffsets.back() == clusterPortals.size() && connOffsets.back() == conns.size();
+    for (size_t i = 1; ok && i < clusterOffsets.size(); ++i)
+      ok = clusterOffsets[i - 1] <= clusterOffsets[i];
+    for (size_t i = 1; ok && i < connOffsets.size(); ++i)
+      ok = connOffsets[i - 1] <= connOffsets[i];
+    for (uint32_t idx : clusterPortals)
+      ok = ok && idx < portals.size();
+    for (const PortalConnection &conn : conns)
+      ok = ok && conn.connIdx < portals.size() && conn.clusterIdx < numClusters;
+  }
+  if (!ok)
+    close();
+  return ok;
+}
+
+void NavCache::close()
+{
+#ifdef _WIN32
+  if (data)
+    UnmapViewOfFile(data);
+  if (mapping)
+    CloseHandle(mapping);
+  if (file)
+    CloseHandle(file);
+  mapping = nullptr;
+  file = nullptr;
+#else
+  if (data)
+    munmap(const_cast<uint8_t *>(data), size);
+#endif
+  data = nullptr;
+  size = 0;
+}
+
+template<typename T>
+std::span<const T> NavCache::get_section(SectionKind kind, uint32_t level) const
+{
+  const Section *sections = reinterpret_cast<const Section *>(data + sizeof(Header));
+  for (uint32_t i = 0; i < get_header().numSections; ++i)
+  {
+    const Section &section = sections[i];
+    if (section.kind != kind || section.level != level)
+      continue;
+    if (section.offset % alignof(T) != 0 || section.offset > size ||
+        section.count > (size - section.offset) / sizeof(T))
+      return std::span<const T>();
+    return std::span<const T>(reinterpret_cast<const T *>(data + section.offset), size_t(section.count));
+  }
+  return std::span<const T>();
+}
+
+bool NavCache::save(const char *path, const DungeonData &dd, const DungeonPortals &dp,
+                    const std::vector<size_t> &cluster_sizes, const MapRegions &regions)
+{
+  Writer writer;
+  writer.add(SectionKind::Tiles, 0, dd.tiles);
+  const std::vector<uint64_t> clusterSizes(cluster_sizes.begin(), cluster_sizes.end());
+  writer.add(SectionKind::ClusterSizes, 0, clusterSizes);
+
+  // roots are renumbered densely, so loading needs no more labels than there are tiles
+  std::vector<uint32_t> labels(dd.width * dd.height);
+  std::vector<uint32_t> dense;
+  uint32_t numLabels = 0;
+  for (size_t i = 0; i < labels.size(); ++i)
+  {
+    const uint32_t region = regions.get_region(i);
+    if (region == MapRegions::no_region)
+    {
+      labels[i] = MapRegions::no_region;
+      continue;
+    }
+    if (region >= dense.size())
+      dense.resize(size_t(region) + 1, MapRegions::no_region);
+    if (dense[region] == MapRegions::no_region)
+      dense[region] = numLabels++;
+    labels[i] = dense[region];
+  }
+  writer.add(SectionKind::RegionLabels, 0, labels);
+
+  writer.add(SectionKind::Portals, 0, dp.portals);
+  writer.add(SectionKind::FreePortals, 0, dp.freePortals);
+
+  std::vector<uint64_t> splits;
+  for (size_t level = 0; level < get_num_levels(dp); ++level)
+    splits.push_back(get_level_split(dp, level));
+  writer.add(SectionKind::LevelSplits, 0, splits);
+
+  for (uint32_t level = 0; level < get_num_levels(dp); ++level)
+  {
+    // the file keeps packed rows only, rows left with holes by repairs are packed in a copy
+    PortalLevel packed;
+    const PortalLevel *levelRows = &dp.levels[level];
+    if (!is_packed(*levelRows))
+    {
+      packed = *levelRows;
+      pack_portal_level(packed);
+      levelRows = &packed;
+    }
+    const PortalLevel &pl = *levelRows;
+    writer.add(SectionKind::ClusterOffsets, level, pl.clusterOffsets);
+    writer.add(SectionKind::ClusterPortals, level, pl.clusterPortals);
+    writer.add(SectionKind::ConnOffsets, level, pl.connOffsets);
+    writer.add(SectionKind::Conns, level, pl.conns);
+  }
+  return writer.write(path, dd);
+}
+
+std::string NavCache::get_path(const char *dir, const DungeonData &dd)
+{
+  char name[64];
+  snprintf(name, sizeof(name), "nav_%zux%zu_%016" PRIx64 ".bin", dd.width, dd.height,
+           hash_tiles(dd.tiles.data(), dd.tiles.size()));
+  return (std::filesystem::path(dir) / name).string();
+}
+
+bool NavCache::matches(const DungeonData &dd, const std::vector<size_t> &cluster_sizes) const
+{
+  if (!data)
+    return false;
+  const Header &header = get_header();
+  if (header.width != dd.width || header.height != dd.height ||
+      header.tilesHash != hash_tiles(dd.tiles.data(), dd.tiles.size()))
+    return false;
+  // the hash could collide, tiles themselves are right here
+  std::span<const char> tiles = get_tiles();
+  if (memcmp(tiles.data(), dd.tiles.data(), tiles.size()) != 0)
+    return false;
+  std::span<const uint64_t> sizes = get_section<uint64_t>(SectionKind::ClusterSizes);
+  return std::equal(sizes.begin(), sizes.end(), cluster_sizes.begin(), cluster_sizes.end());
+}
+
+size_t NavCache::get_width() const { return data ? size_t(get_header().width) : 0; }
+size_t NavCache::get_height() const { return data ? size_t(get_header().height) : 0; }
+
+std::span<const char> NavCache::get_tiles() const
+{
+  return get_section<char>(SectionKind::Tiles);
+}
+
+std::span<const uint32_t> NavCache::get_region_labels() const
+{
+  return get_section<uint32_t>(SectionKind::RegionLabels);
+}
+
+void NavCache::load_portals(DungeonPortals &dp) const
+{
+  std::span<const uint64_t> splits = get_section<uint64_t>(SectionKind::LevelSplits);
+  std::span<const PathPortal> portals = get_section<PathPortal>(SectionKind::Portals);
+  std::span<const uint32_t> freePortals = get_section<uint32_t>(SectionKind::FreePortals);
+
+  dp = DungeonPortals{};
+  dp.portals.assign(portals.begin(), portals.end());
+  dp.freePortals.assign(freePortals.begin(), freePortals.end());
+  for (uint32_t level = 0; level < splits.size(); ++level)
+  {
+    std::span<const uint32_t> clusterOffsets = get_section<uint32_t>(SectionKind::ClusterOffsets, level);
+    std::span<const uint32_t> clusterPortals = get_section<uint32_t>(SectionKind::ClusterPortals, level);
+    std::span<const uint32_t> connOffsets = get_section<uint32_t>(SectionKind::ConnOffsets, level);
+    std::span<const PortalConnection> conns = get_section<PortalConnection>(SectionKind::Conns, level);
+    // packed rows end where the next ones begin
+    dp.levels.push_back(PortalLevel{size_t(splits[level]),
+                                    std::vector<uint32_t>(clusterOffsets.begin(), clusterOffsets.end()),
+                                    std::vector<uint32_t>(clusterOffsets.begin() + 1, clusterOffsets.end()),
+                                    std::vector<uint32_t>(clusterPortals.begin(), clusterPortals.end()),
+                                    std::vector<uint32_t>(connOffsets.begin(), connOffsets.end()),
+                                    std::vector<uint32_t>(connOffsets.begin() + 1, connOffsets.end()),
+                                    std::vector<PortalConnection>(conns.begin(), conns.end()), 0, 0});
+  }
+}
+
+void NavCache::load_regions(MapRegions &regions) const
+{
+  regions.assign(get_region_labels().data(), get_width(), get_height());
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include "ecsTypes.h"
+#include "pathfinder.h"
+#include "mapRegions.h"
+
+uint64_t hash_tiles(const char *tiles, size_t count);
+
+// Tiles together with the navigation data derived from them, in one versioned file.
+// The file is memory mapped and every section is a flat array aligned to a cache line,
+// views point straight into the mapping, so opening it costs nothing but the page faults.
+// Portals and regions are copied out of the views in bulk when they're loaded,
+// they're edited in place when the map changes and the mapping is read only.
+class NavCache
+{
+public:
+  // bumped on every change of the layout, files of other versions are rebuilt
+  static constexpr uint32_t version = 2;
+
+  NavCache() = default;
+  NavCache(const NavCache &) = delete;
+  NavCache &operator=(const NavCache &) = delete;
+  ~NavCache() { close(); }
+
+  // false if there's no file or it's not a valid cache of this version
+  bool open(const char *path);
+  void close();
+
+  static bool save(const char *path, const DungeonData &dd, const DungeonPortals &dp,
+                   const std::vector<size_t> &cluster_sizes, const MapRegions &regions);
+  // cache file for the tiles in the directory, named after their hash
+  static std::string get_path(const char *dir, const DungeonData &dd);
+
+  // it's a cache of exactly these tiles, built with these cluster sizes
+  bool matches(const DungeonData &dd, const std::vector<size_t> &cluster_sizes) const;
+
+  size_t get_width() const;
+  size_t get_height() const;
+  std::span<const char> get_tiles() const;
+  // root label of every tile, MapRegions::no_region for walls
+  std::span<const uint32_t> get_region_labels() const;
+
+  void load_portals(DungeonPortals &dp) const;
+  void load_regions(MapRegions &regions) const;
+
+private:
+  enum class SectionKind : uint32_t
+  {
+    Tiles,
+    ClusterSizes,
+    RegionLabels,
+    Portals, // PathPortal as is, removed ones included
+    FreePortals,
+    LevelSplits,
+    // per level, the compressed rows of PortalLevel as they are
+    ClusterOffsets,
+    ClusterPortals,
+    ConnOffsets,
+    Conns,
+  };
+
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t numSections;
+    uint64_t tilesHash;
+    uint64_t width;
+    uint64_t height;
+  };
+
+  struct Section
+  {
+    SectionKind kind;
+    uint32_t level;
+    uint64_t offset;
+    uint64_t count;
+  };
+
+  class Writer;
+
+  const Header &get_header() const { return *reinterpret_cast<const Header *>(data); }
+  template<typename T>
+  std::span<const T> get_section(SectionKind kind, uint32_t level = 0) const;
+
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  void *file = nullptr;
+  void *mapping = nullptr;
+#endif
+};
@@ -0,0 +1,46 @@
+#include "pathBatch.h"
+#include "workers.h"
+#include <algorithm>
+#include <atomic>
+
+size_t find_paths(PathBatchContext &ctx, const DungeonData &dd, const DungeonPortals &dp, const MapRegions *regions,
+                  std::span<const PathRequest> requests, std::span<PathResult> results, std::span<IVec2> arena,
+                  size_t num_threads)
+{
+  // results are indexed by requests
+  if (results.size() < requests.size())
+    return 0;
+  num_threads = std::min(get_num_threads(num_threads), std::max(requests.size(), size_t(1)));
+  if (ctx.workers.size() < num_threads)
+    ctx.workers.resize(num_threads);
+  // region queries don't write anything after it, so workers could share them
+  if (regions)
+    regions->flatten();
+
+  std::atomic<size_t> nextWorker = 0;
+  std::atomic<size_t> nextRequest = 0;
+  std::atomic<size_t> arenaUsed = 0;
+  run_workers(num_threads, [&]()
+  {
+    PathBatchContext::Worker &worker = ctx.workers[nextWorker++];
+    for (size_t i = nextRequest++; i < requests.size(); i = nextRequest++)
+    {
+      const PathRequest &request = requests[i];
+      PathResult &result = results[i];
+      result = PathResult{};
+      worker.tiles.clear();
+      if (!find_path_hierarchical(worker.search, dd, dp, request.from, request.to, worker.path, worker.tiles, regions))
+        continue;
+      // a path which doesn't fit still takes its room, so the arena is never written past its end
+      const size_t offset = arenaUsed.fetch_add(worker.tiles.size());
+      if (offset + worker.tiles.size() > arena.size())
+      {
+        result.status = PathResult::Status::ArenaFull;
+        continue;
+      }
+      std::copy(worker.tiles.begin(), worker.tiles.end(), arena.begin() + std::ptrdiff_t(offset));
+      result = PathResult{PathResult::Status::Found, uint32_t(offset), uint32_t(worker.tiles.size())};
+    }
+  });
+  return arenaUsed.load();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "math.h"
+#include "hpaPathfinder.h"
+
+struct PathRequest
+{
+  IVec2 from;
+  IVec2 to;
+};
+
+struct PathResult
+{
+  enum class Status : uint8_t
+  {
+    Found,
+    NotFound,
+    ArenaFull, // there's a path, but the arena had no room left for it
+  };
+
+  Status status = Status::NotFound;
+  // tiles of the path, start and goal included, are arena[offset, offset + length)
+  uint32_t offset = 0;
+  uint32_t length = 0;
+};
+
+// Search state of every worker thread, kept between batches,
+// so nothing is allocated for the searches once it has warmed up.
+struct PathBatchContext
+{
+  struct Worker
+  {
+    HierarchicalSearchContext search;
+    HierarchicalPath path;
+    std::vector<IVec2> tiles;
+  };
+
+  std::vector<Worker> workers;
+};
+
+// Hierarchical paths for all requests at once, results has an entry per request. num_threads workers
+// (0 is all hardware threads) grab requests one by one, each with its own search context, and copy
+// paths into the caller's arena. Paths are the same as find_path_hierarchical gives for any number
+// of threads, only where they land in the arena depends on the order workers finish them.
+// Returns the number of tiles all found paths take, if it's more than the arena holds
+// some of them are ArenaFull and the batch could be rerun with an arena of this size.
+// A results span shorter than requests is an error, nothing is searched and 0 is returned.
+size_t find_paths(PathBatchContext &ctx, const DungeonData &dd, const DungeonPortals &dp, const MapRegions *regions,
+                  std::span<const PathRequest> requests, std::span<PathResult> results, std::span<IVec2> arena,
+                  size_t num_threads = 0);
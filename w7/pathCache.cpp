@@ -0,0 +1,144 @@
+#include "pathCache.h"
+
+bool PathCache::find(IVec2 from, IVec2 to, uint32_t revision, std::vector<IVec2> &res)
+{
+  set_revision(revision);
+  auto it = keys.find(pack(from, to));
+  if (it != keys.end())
+  {
+    unlink(it->second);
+    link_front(it->second);
+    res = slots[it->second].path;
+    stats.hits++;
+    return true;
+  }
+  auto suffix = suffixes.find(pack(from, to));
+  if (suffix == suffixes.end())
+  {
+    stats.misses++;
+    return false;
+  }
+  const TileRef ref = suffix->second;
+  unlink(ref.slot);
+  link_front(ref.slot);
+  const std::vector<IVec2> &path = slots[ref.slot].path;
+  res.assign(path.begin() + ref.offset, path.end());
+  stats.hits++;
+  stats.suffixHits++;
+  return true;
+}
+
+void PathCache::insert(IVec2 from, IVec2 to, uint32_t revision, const std::vector<IVec2> &path)
+{
+  set_revision(revision);
+  if (path.empty() || path.size() > maxTiles || keys.count(pack(from, to)))
+    return;
+  while (numTiles + path.size() > maxTiles)
+  {
+    evict(tail);
+    stats.evictions++;
+  }
+  uint32_t slot = uint32_t(slots.size());
+  if (!freeSlots.empty())
+  {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  }
+  else
+    slots.emplace_back();
+  Entry &entry = slots[slot];
+  entry.key = pack(from, to);
+  entry.to = to;
+  entry.path = path;
+  numTiles += path.size();
+  keys[entry.key] = slot;
+  link_front(slot);
+  // the last tile is the goal itself, it's an exact key if it's ever queried
+  for (size_t i = 0; i + 1 < path.size(); ++i)
+    suffixes[pack(path[i], to)] = TileRef{slot, uint32_t(i)};
+}
+
+void PathCache::clear()
+{
+  slots.clear();
+  freeSlots.clear();
+  keys.clear();
+  suffixes.clear();
+  head = invalid_slot;
+  tail = invalid_slot;
+  numTiles = 0;
+}
+
+float PathCache::get_hit_rate() const
+{
+  const size_t total = stats.hits + stats.misses;
+  return total > 0 ? float(stats.hits) / float(total) : 0.f;
+}
+
+size_t PathCache::get_allocated_bytes() const
+{
+  // a node of a std::unordered_map is the value with a next pointer, plus a bucket pointer
+  constexpr size_t keyNode = sizeof(std::pair<const uint64_t, uint32_t>) + sizeof(void *);
+  constexpr size_t suffixNode = sizeof(std::pair<const uint64_t, TileRef>) + sizeof(void *);
+  size_t res = slots.capacity() * sizeof(Entry) + freeSlots.capacity() * sizeof(uint32_t);
+  for (const Entry &entry : slots)
+    res += entry.path.capacity() * sizeof(IVec2);
+  res += keys.size() * keyNode + keys.bucket_count() * sizeof(void *);
+  res += suffixes.size() * suffixNode + suffixes.bucket_count() * sizeof(void *);
+  return res;
+}
+
+void PathCache::set_revision(uint32_t revision)
+{
+  if (revision == curRevision)
+    return;
+  curRevision = revision;
+  if (keys.empty())
+    return;
+  clear();
+  stats.invalidations++;
+}
+
+void PathCache::link_front(uint32_t slot)
+{
+  Entry &entry = slots[slot];
+  entry.prev = invalid_slot;
+  entry.next = head;
+  if (head != invalid_slot)
+    slots[head].prev = slot;
+  head = slot;
+  if (tail == invalid_slot)
+    tail = slot;
+}
+
+void PathCache::unlink(uint32_t slot)
+{
+  Entry &entry = slots[slot];
+  if (entry.prev != invalid_slot)
+    slots[entry.prev].next = entry.next;
+  else
+    head = entry.next;
+  if (entry.next != invalid_slot)
+    slots[entry.next].prev = entry.prev;
+  else
+    tail = entry.prev;
+  entry.prev = invalid_slot;
+  entry.next = invalid_slot;
+}
+
+void PathCache::evict(uint32_t slot)
+{
+  unlink(slot);
+  Entry &entry = slots[slot];
+  // tiles shared with a newer path point to that one already
+  for (size_t i = 0; i + 1 < entry.path.size(); ++i)
+  {
+    auto it = suffixes.find(pack(entry.path[i], entry.to));
+    if (it != suffixes.end() && it->second.slot == slot)
+      suffixes.erase(it);
+  }
+  keys.erase(entry.key);
+  numTiles -= entry.path.size();
+  entry.path = std::vector<IVec2>();
+  freeSlots.push_back(slot);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "math.h"
+
+// Bounded LRU cache of tile paths in front of the pathfinders, keyed by start, goal and map revision.
+// When there's no path from this exact start, a cached path to the same goal which goes through
+// the start is reused from there on, so agents following each other share one search.
+// All entries are of one revision, a query with another one drops them all.
+// Failed searches aren't cached, regions reject most of them without a search anyway.
+class PathCache
+{
+public:
+  struct Stats
+  {
+    size_t hits = 0;
+    size_t suffixHits = 0; // included in hits
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t invalidations = 0;
+  };
+
+  // budget is in path tiles, paths longer than it aren't cached
+  explicit PathCache(size_t max_tiles = 1 << 18) : maxTiles(max_tiles) {}
+
+  // false on a miss, res is left untouched then
+  bool find(IVec2 from, IVec2 to, uint32_t revision, std::vector<IVec2> &res);
+  void insert(IVec2 from, IVec2 to, uint32_t revision, const std::vector<IVec2> &path);
+  void clear();
+
+  // cached path, or the one find_path(from, to) returns which is cached then
+  template<typename Callable>
+  std::vector<IVec2> get_path(IVec2 from, IVec2 to, uint32_t revision, Callable find_path)
+  {
+    std::vector<IVec2> res;
+    if (find(from, to, revision, res))
+      return res;
+    res = find_path(from, to);
+    insert(from, to, revision, res);
+    return res;
+  }
+
+  const Stats &get_stats() const { return stats; }
+  float get_hit_rate() const;
+  size_t get_num_entries() const { return keys.size(); }
+  size_t get_num_tiles() const { return numTiles; }
+  // paths, slots and both hash maps, node sizes of the maps are estimated
+  size_t get_allocated_bytes() const;
+
+private:
+  static constexpr uint32_t invalid_slot = 0xffffffff;
+
+  struct Entry
+  {
+    uint64_t key;
+    IVec2 to;
+    std::vector<IVec2> path;
+    // LRU list, head is the most recently used
+    uint32_t prev = invalid_slot;
+    uint32_t next = invalid_slot;
+  };
+
+  // where a tile lies on a cached path
+  struct TileRef
+  {
+    uint32_t slot;
+    uint32_t offset;
+  };
+
+  // pair of tiles packed into one key, coordinates are 16 bit like portal bounds
+  static uint64_t pack(IVec2 a, IVec2 b)
+  {
+    return uint64_t(uint16_t(a.x)) << 48 | uint64_t(uint16_t(a.y)) << 32 | uint64_t(uint16_t(b.x)) << 16 | uint16_t(b.y);
+  }
+
+  void set_revision(uint32_t revision);
+  void link_front(uint32_t slot);
+  void unlink(uint32_t slot);
+  void evict(uint32_t slot);
+
+  size_t maxTiles;
+  size_t numTiles = 0;
+  uint32_t curRevision = 0;
+  std::vector<Entry> slots;
+  std::vector<uint32_t> freeSlots;
+  uint32_t head = invalid_slot;
+  uint32_t tail = invalid_slot;
+  std::unordered_map<uint64_t, uint32_t> keys; // (from, to) -> slot
+  std::unordered_map<uint64_t, TileRef> suffixes; // (tile, to) -> the latest cached path through it
+  Stats stats;
+};
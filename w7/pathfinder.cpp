@@ -1,241 +1,937 @@
 #include "pathfinder.h"
+#include "flowField.h"
 #include "dungeonUtils.h"
+#include "navCache.h"
+#include "workers.h"
 #include "math.h"
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <limits>
+#include <tuple>
 
 float heuristic(IVec2 lhs, IVec2 rhs)
 {
   return sqrtf(sqr(float(lhs.x - rhs.x)) + sqr(float(lhs.y - rhs.y)));
 };
 
-template<typename T>
-static size_t coord_to_idx(T x, T y, size_t w)
+void append_path(const AStarContext &ctx, IVec2 to, size_t width, std::vector<IVec2> &res, bool with_start)
 {
-  return size_t(y) * w + size_t(x);
+  // written from the end, then the appended part is flipped in place
+  const size_t first = res.size();
+  uint32_t idx = uint32_t(coord_to_idx(to.x, to.y, width));
+  while (idx != AStarContext::invalid_idx)
+  {
+    res.push_back(IVec2{int(idx % width), int(idx / width)});
+    idx = ctx.get_prev(idx);
+  }
+  if (!with_start)
+    res.pop_back();
+  std::reverse(res.begin() + std::ptrdiff_t(first), res.end());
 }
 
-static std::vector<IVec2> reconstruct_path(std::vector<IVec2> prev, IVec2 to, size_t width)
+std::vector<IVec2> reconstruct_path(const AStarContext &ctx, IVec2 to, size_t width)
 {
-  IVec2 curPos = to;
-  std::vector<IVec2> res = {curPos};
-  while (prev[coord_to_idx(curPos.x, curPos.y, width)] != IVec2{-1, -1})
-  {
-    curPos = prev[coord_to_idx(curPos.x, curPos.y, width)];
-    res.insert(res.begin(), curPos);
-  }
+  std::vector<IVec2> res;
+  append_path(ctx, to, width, res);
   return res;
 }
 
-static std::vector<IVec2> find_path_a_star(const DungeonData &dd, IVec2 from, IVec2 to,
-                                           IVec2 lim_min, IVec2 lim_max)
+bool find_path_a_star(AStarContext &ctx, const DungeonData &dd, IVec2 from, IVec2 to,
+                      IVec2 lim_min, IVec2 lim_max, std::vector<IVec2> &res, const MapRegions *regions)
 {
+  ctx.begin_query(dd.width, dd.height);
   if (from.x < 0 || from.y < 0 || from.x >= int(dd.width) || from.y >= int(dd.height))
-    return std::vector<IVec2>();
-  size_t inpSize = dd.width * dd.height;
-
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<float> f(inpSize, std::numeric_limits<float>::max());
-  std::vector<IVec2> prev(inpSize, {-1,-1});
-
-  auto getG = [&](IVec2 p) -> float { return g[coord_to_idx(p.x, p.y, dd.width)]; };
-  auto getF = [&](IVec2 p) -> float { return f[coord_to_idx(p.x, p.y, dd.width)]; };
-
-  g[coord_to_idx(from.x, from.y, dd.width)] = 0;
-  f[coord_to_idx(from.x, from.y, dd.width)] = heuristic(from, to);
+    return false;
+  if (to.x < 0 || to.y < 0 || to.x >= int(dd.width) || to.y >= int(dd.height))
+    return false;
+  if (regions && !regions->is_reachable(coord_to_idx(from.x, from.y, dd.width), coord_to_idx(to.x, to.y, dd.width)))
+    return false;
 
-  std::vector<IVec2> openList = {from};
-  std::vector<IVec2> closedList;
+  const uint32_t toIdx = uint32_t(coord_to_idx(to.x, to.y, dd.width));
+  ctx.push(uint32_t(coord_to_idx(from.x, from.y, dd.width)), 0.f, heuristic(from, to), AStarContext::invalid_idx);
 
-  while (!openList.empty())
+  while (!ctx.empty())
   {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
+    const uint32_t curIdx = ctx.pop();
+    if (curIdx == toIdx)
     {
-      float score = getF(openList[i]);
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
+      append_path(ctx, to, dd.width, res);
+      return true;
     }
-    if (openList[bestIdx] == to)
-      return reconstruct_path(prev, to, dd.width);
-    IVec2 curPos = openList[bestIdx];
-    openList.erase(openList.begin() + bestIdx);
-    if (std::find(closedList.begin(), closedList.end(), curPos) != closedList.end())
-      continue;
-    size_t idx = coord_to_idx(curPos.x, curPos.y, dd.width);
-    closedList.emplace_back(curPos);
+    ctx.close(curIdx);
+    ctx.numExpanded++;
+    const IVec2 curPos{int(curIdx % dd.width), int(curIdx / dd.width)};
+    const float curG = ctx.get_g(curIdx);
     auto checkNeighbour = [&](IVec2 p)
     {
       // out of bounds
       if (p.x < lim_min.x || p.y < lim_min.y || p.x >= lim_max.x || p.y >= lim_max.y)
         return;
-      size_t idx = coord_to_idx(p.x, p.y, dd.width);
+      const uint32_t idx = uint32_t(coord_to_idx(p.x, p.y, dd.width));
       // not empty
-      if (dd.tiles[idx] == dungeon::wall)
+      if (!dd.walkGrid.is_walkable(p.x, p.y) || ctx.is_closed(idx))
         return;
       float edgeWeight = 1.f;
-      float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
-      if (gScore < getG(p))
-      {
-        prev[idx] = curPos;
-        g[idx] = gScore;
-        f[idx] = gScore + heuristic(p, to);
-      }
-      bool found = std::find(openList.begin(), openList.end(), p) != openList.end();
-      if (!found)
-        openList.emplace_back(p);
+      float gScore = curG + 1.f * edgeWeight; // we're exactly 1 unit away
+      if (gScore < ctx.get_g(idx))
+        ctx.push(idx, gScore, gScore + heuristic(p, to), curIdx);
     };
     checkNeighbour({curPos.x + 1, curPos.y + 0});
     checkNeighbour({curPos.x - 1, curPos.y + 0});
     checkNeighbour({curPos.x + 0, curPos.y + 1});
     checkNeighbour({curPos.x + 0, curPos.y - 1});
   }
-  // empty path
-  return std::vector<IVec2>();
+  return false;
 }
 
-
-void prebuild_map(flecs::world &ecs)
+std::vector<IVec2> find_path_a_star(AStarContext &ctx, const DungeonData &dd, IVec2 from, IVec2 to,
+                                    IVec2 lim_min, IVec2 lim_max, const MapRegions *regions)
 {
-  auto mapQuery = ecs.query<const DungeonData>();
+  std::vector<IVec2> res;
+  find_path_a_star(ctx, dd, from, to, lim_min, lim_max, res, regions);
+  return res;
+}
 
-  constexpr size_t splitTiles = 10;
-  ecs.defer([&]()
+void flood_area(AStarContext &ctx, const DungeonData &dd, IVec2 from, IVec2 lim_min, IVec2 lim_max)
+{
+  ctx.begin_query(dd.width, dd.height);
+  if (from.x < lim_min.x || from.y < lim_min.y || from.x >= lim_max.x || from.y >= lim_max.y)
+    return;
+  ctx.push(uint32_t(coord_to_idx(from.x, from.y, dd.width)), 0.f, 0.f, AStarContext::invalid_idx);
+  while (!ctx.empty())
   {
-    mapQuery.each([&](flecs::entity e, const DungeonData &dd)
+    const uint32_t curIdx = ctx.pop();
+    ctx.close(curIdx);
+    ctx.numExpanded++;
+    const IVec2 curPos{int(curIdx % dd.width), int(curIdx / dd.width)};
+    const float gScore = ctx.get_g(curIdx) + 1.f;
+    auto checkNeighbour = [&](IVec2 p)
     {
-      // go through each super tile
-      const size_t width = dd.width / splitTiles;
-      const size_t height = dd.height / splitTiles;
+      if (p.x < lim_min.x || p.y < lim_min.y || p.x >= lim_max.x || p.y >= lim_max.y)
+        return;
+      const uint32_t idx = uint32_t(coord_to_idx(p.x, p.y, dd.width));
+      if (!dd.walkGrid.is_walkable(p.x, p.y) || ctx.is_closed(idx))
+        return;
+      if (gScore < ctx.get_g(idx))
+        ctx.push(idx, gScore, gScore, curIdx);
+    };
+    checkNeighbour({curPos.x + 1, curPos.y + 0});
+    checkNeighbour({curPos.x - 1, curPos.y + 0});
+    checkNeighbour({curPos.x + 0, curPos.y + 1});
+    checkNeighbour({curPos.x + 0, curPos.y - 1});
+  }
+}
+
 
-      auto check_border = [&](size_t xx, size_t yy,
-                              size_t dir_x, size_t dir_y,
-                              int offs_x, int offs_y,
-                              std::vector<PathPortal> &portals)
+template<typename T>
+struct RowItem
+{
+  uint32_t row;
+  T item;
+};
+
+// connection of the portal in row, found while processing one cluster
+using ClusterConnection = RowItem<PortalConnection>;
+
+// Compressed rows of num_rows rows, items of a row stay in the order they were added.
+template<typename T>
+static void fill_rows(std::vector<uint32_t> &offsets, std::vector<uint32_t> &ends, std::vector<T> &items,
+                      size_t num_rows, std::vector<RowItem<T>> &added)
+{
+  std::stable_sort(added.begin(), added.end(), [](const RowItem<T> &lhs, const RowItem<T> &rhs) { return lhs.row < rhs.row; });
+  offsets.clear();
+  ends.clear();
+  items.clear();
+  offsets.reserve(num_rows + 1);
+  ends.reserve(num_rows);
+  items.reserve(added.size());
+  size_t next = 0;
+  for (size_t row = 0; row < num_rows; ++row)
+  {
+    offsets.push_back(uint32_t(items.size()));
+    for (; next < added.size() && added[next].row == row; ++next)
+      items.push_back(added[next].item);
+    ends.push_back(uint32_t(items.size()));
+  }
+  offsets.push_back(uint32_t(items.size()));
+}
+
+// new rows are empty and begin at the end of the array
+static void add_rows(std::vector<uint32_t> &offsets, std::vector<uint32_t> &ends, size_t num_rows)
+{
+  if (ends.size() >= num_rows)
+    return;
+  const uint32_t end = offsets.back();
+  offsets.resize(num_rows + 1, end);
+  ends.resize(num_rows, end);
+}
+
+// A row which doesn't grow is rewritten in place, a longer one is moved to the end of the array.
+template<typename T>
+static void set_row(std::vector<uint32_t> &offsets, std::vector<uint32_t> &ends, std::vector<T> &items,
+                    size_t &holes, size_t row, std::span<const T> row_items)
+{
+  const size_t oldSize = ends[row] - offsets[row];
+  if (row_items.size() > oldSize)
+  {
+    holes += oldSize;
+    offsets[row] = uint32_t(items.size());
+    items.insert(items.end(), row_items.begin(), row_items.end());
+    offsets.back() = uint32_t(items.size());
+  }
+  else
+  {
+    holes += oldSize - row_items.size();
+    std::copy(row_items.begin(), row_items.end(), items.begin() + std::ptrdiff_t(offsets[row]));
+  }
+  ends[row] = offsets[row] + uint32_t(row_items.size());
+}
+
+template<typename T>
+static void pack_rows(std::vector<uint32_t> &offsets, std::vector<uint32_t> &ends, std::vector<T> &items, size_t &holes)
+{
+  std::vector<T> packed;
+  packed.reserve(items.size() - holes);
+  for (size_t row = 0; row < ends.size(); ++row)
+  {
+    const uint32_t begin = uint32_t(packed.size());
+    packed.insert(packed.end(), items.begin() + std::ptrdiff_t(offsets[row]), items.begin() + std::ptrdiff_t(ends[row]));
+    offsets[row] = begin;
+    ends[row] = uint32_t(packed.size());
+  }
+  offsets.back() = uint32_t(packed.size());
+  items.swap(packed);
+  holes = 0;
+}
+
+template<typename T>
+static bool are_rows_packed(const std::vector<uint32_t> &offsets, const std::vector<uint32_t> &ends,
+                            const std::vector<T> &items)
+{
+  for (size_t row = 0; row < ends.size(); ++row)
+    if (ends[row] != offsets[row + 1])
+      return false;
+  return offsets.back() == items.size();
+}
+
+void pack_portal_level(PortalLevel &pl)
+{
+  pack_rows(pl.clusterOffsets, pl.clusterEnds, pl.clusterPortals, pl.clusterHoles);
+  pack_rows(pl.connOffsets, pl.connEnds, pl.conns, pl.connHoles);
+}
+
+bool is_packed(const PortalLevel &pl)
+{
+  return are_rows_packed(pl.clusterOffsets, pl.clusterEnds, pl.clusterPortals) &&
+         are_rows_packed(pl.connOffsets, pl.connEnds, pl.conns);
+}
+
+// One BFS per portal, seeded from all of its tiles inside the cluster, gives
+// the closest tile-to-tile distance to every other portal of the cluster at once.
+// Only reads portals, connections are written to res, so clusters could be processed in parallel.
+static void connect_cluster_portals(const DungeonData &dd, IVec2 lim_min, IVec2 lim_max, size_t cluster_idx,
+                                    std::span<const uint32_t> indices, const std::vector<PathPortal> &portals,
+                                    std::vector<uint32_t> &dist, std::vector<uint32_t> &queue,
+                                    std::vector<ClusterConnection> &res)
+{
+  constexpr uint32_t unreached = 0xffffffff;
+  const size_t clusterWidth = size_t(lim_max.x - lim_min.x);
+  const size_t clusterHeight = size_t(lim_max.y - lim_min.y);
+  dist.resize(clusterWidth * clusterHeight);
+  queue.reserve(clusterWidth * clusterHeight);
+
+  // calls c(local_idx) for each tile of the portal inside of the cluster
+  auto for_each_portal_tile = [&](const PathPortal &portal, auto c)
+  {
+    for (int y = std::max(int(portal.startY), lim_min.y); y <= std::min(int(portal.endY), lim_max.y - 1); ++y)
+      for (int x = std::max(int(portal.startX), lim_min.x); x <= std::min(int(portal.endX), lim_max.x - 1); ++x)
+        c(uint32_t(coord_to_idx(x - lim_min.x, y - lim_min.y, clusterWidth)));
+  };
+
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    std::fill(dist.begin(), dist.end(), unreached);
+    queue.clear();
+    for_each_portal_tile(portals[indices[i]], [&](uint32_t idx)
+    {
+      dist[idx] = 0;
+      queue.push_back(idx);
+    });
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+      const uint32_t cur = queue[head];
+      const size_t x = cur % clusterWidth;
+      const size_t y = cur / clusterWidth;
+      auto checkNeighbour = [&](size_t nx, size_t ny)
       {
-        int spanFrom = -1;
-        int spanTo = -1;
-        for (size_t i = 0; i < splitTiles; ++i)
-        {
-          size_t x = xx * splitTiles + i * dir_x;
-          size_t y = yy * splitTiles + i * dir_y;
-          size_t nx = x + offs_x;
-          size_t ny = y + offs_y;
-          if (dd.tiles[y * dd.width + x] != dungeon::wall &&
-              dd.tiles[ny * dd.width + nx] != dungeon::wall)
-          {
-            if (spanFrom < 0)
-              spanFrom = i;
-            spanTo = i;
-          }
-          else if (spanFrom >= 0)
-          {
-            // write span
-            portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                               yy * splitTiles + spanFrom * dir_y + offs_y,
-                               xx * splitTiles + spanTo * dir_x,
-                               yy * splitTiles + spanTo * dir_y});
-            spanFrom = -1;
-          }
-        }
-        if (spanFrom >= 0)
-        {
-          portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                             yy * splitTiles + spanFrom * dir_y + offs_y,
-                             xx * splitTiles + spanTo * dir_x,
-                             yy * splitTiles + spanTo * dir_y});
-        }
+        // out of bounds, unsigned wrap takes care of negative coords
+        if (nx >= clusterWidth || ny >= clusterHeight)
+          return;
+        const uint32_t idx = uint32_t(coord_to_idx(nx, ny, clusterWidth));
+        if (dist[idx] != unreached)
+          return;
+        if (!dd.walkGrid.is_walkable(int(nx) + lim_min.x, int(ny) + lim_min.y))
+          return;
+        dist[idx] = dist[cur] + 1;
+        queue.push_back(idx);
       };
+      checkNeighbour(x + 1, y);
+      checkNeighbour(x - 1, y);
+      checkNeighbour(x, y + 1);
+      checkNeighbour(x, y - 1);
+    }
+    for (size_t j = i + 1; j < indices.size(); ++j)
+    {
+      uint32_t minDist = unreached;
+      for_each_portal_tile(portals[indices[j]], [&](uint32_t idx) { minDist = std::min(minDist, dist[idx]); });
+      if (minDist == unreached)
+        continue;
+      // score is a length of the path in tiles, the same as the size of find_path_a_star output
+      const float score = float(minDist + 1);
+      res.push_back({indices[i], {indices[j], score, uint32_t(cluster_idx)}});
+      res.push_back({indices[j], {indices[i], score, uint32_t(cluster_idx)}});
+    }
+  }
+}
+
+static void check_border(const DungeonData &dd, size_t split_tiles,
+                         size_t xx, size_t yy,
+                         size_t dir_x, size_t dir_y,
+                         int offs_x, int offs_y,
+                         std::vector<PathPortal> &portals)
+{
+  int spanFrom = -1;
+  int spanTo = -1;
+  const int startX = int(xx * split_tiles);
+  const int startY = int(yy * split_tiles);
+  auto writeSpan = [&]()
+  {
+    portals.push_back({uint16_t(startX + spanFrom * int(dir_x) + offs_x),
+                       uint16_t(startY + spanFrom * int(dir_y) + offs_y),
+                       uint16_t(startX + spanTo * int(dir_x)),
+                       uint16_t(startY + spanTo * int(dir_y))});
+  };
+  // clusters of the last column and row are cut by the map edge
+  const size_t length = dir_x ? std::min(split_tiles, dd.width - xx * split_tiles)
+                              : std::min(split_tiles, dd.height - yy * split_tiles);
+  for (size_t i = 0; i < length; ++i)
+  {
+    const int x = startX + int(i * dir_x);
+    const int y = startY + int(i * dir_y);
+    if (dd.walkGrid.is_walkable(x, y) && dd.walkGrid.is_walkable(x + offs_x, y + offs_y))
+    {
+      if (spanFrom < 0)
+        spanFrom = int(i);
+      spanTo = int(i);
+    }
+    else if (spanFrom >= 0)
+    {
+      writeSpan();
+      spanFrom = -1;
+    }
+  }
+  if (spanFrom >= 0)
+    writeSpan();
+}
+
+void get_cluster_limits(const DungeonData &dd, size_t split, size_t cluster, IVec2 &lim_min, IVec2 &lim_max)
+{
+  const size_t clustersWidth = get_clusters_width(dd, split);
+  const size_t x = cluster % clustersWidth;
+  const size_t y = cluster / clustersWidth;
+  lim_min = IVec2{int(x * split), int(y * split)};
+  lim_max = IVec2{int(std::min((x + 1) * split, dd.width)), int(std::min((y + 1) * split, dd.height))};
+}
+
+size_t get_parent_cluster(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t cluster)
+{
+  const size_t split = get_level_split(dp, level);
+  const size_t parentSplit = get_level_split(dp, level + 1);
+  const size_t clustersWidth = get_clusters_width(dd, split);
+  const size_t x = cluster % clustersWidth * split / parentSplit;
+  const size_t y = cluster / clustersWidth * split / parentSplit;
+  return y * get_clusters_width(dd, parentSplit) + x;
+}
 
-      std::vector<PathPortal> portals;
-      std::vector<std::vector<size_t>> tilePortalsIndices;
+// Nodes of the level on the top (or left) border of the cluster. Base portals of the border
+// which touch each other form one entrance, it gets a single node: the node of the level below
+// which is the closest to its middle. So nodes of a level are always nodes of the level below.
+static void get_border_nodes(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t cluster,
+                             bool top, std::vector<uint32_t> &res)
+{
+  const size_t split = get_level_split(dp, 0);
+  IVec2 limMin, limMax;
+  get_cluster_limits(dd, get_level_split(dp, level), cluster, limMin, limMax);
+  // base portals of this border, they belong to the base clusters of the first row (or column)
+  std::vector<uint32_t> borderPortals;
+  const size_t clustersWidth = get_clusters_width(dd, split);
+  const size_t from = size_t(top ? limMin.x : limMin.y) / split;
+  const size_t to = (size_t(top ? limMax.x : limMax.y) + split - 1) / split;
+  for (size_t i = from; i < to; ++i)
+  {
+    const size_t baseCluster = top ? size_t(limMin.y) / split * clustersWidth + i
+                                   : i * clustersWidth + size_t(limMin.x) / split;
+    for (uint32_t idx : get_cluster_portals(dp, 0, baseCluster))
+    {
+      const PathPortal &portal = dp.portals[idx];
+      if (top ? int(portal.startY) + 1 == limMin.y && int(portal.endY) == limMin.y
+              : int(portal.startX) + 1 == limMin.x && int(portal.endX) == limMin.x)
+        borderPortals.push_back(idx);
+    }
+  }
+  auto portal_from = [&](uint32_t idx) { return size_t(top ? dp.portals[idx].startX : dp.portals[idx].startY); };
+  auto portal_to = [&](uint32_t idx) { return size_t(top ? dp.portals[idx].endX : dp.portals[idx].endY); };
+  std::sort(borderPortals.begin(), borderPortals.end(),
+            [&](uint32_t lhs, uint32_t rhs) { return portal_from(lhs) < portal_from(rhs); });
 
-      auto push_portals = [&](size_t x, size_t y,
-                              int offs_x, int offs_y,
-                              const std::vector<PathPortal> &new_portals)
+  // portals of the same border are nodes of the level below if they are nodes of its cluster inside of this one
+  auto is_lower_node = [&](uint32_t idx)
+  {
+    if (level == 1)
+      return true;
+    const PathPortal &portal = dp.portals[idx];
+    const size_t lowerSplit = get_level_split(dp, level - 1);
+    const size_t lowerCluster = portal.endY / lowerSplit * get_clusters_width(dd, lowerSplit) + portal.endX / lowerSplit;
+    const std::span<const uint32_t> lowerNodes = get_cluster_portals(dp, level - 1, lowerCluster);
+    return std::find(lowerNodes.begin(), lowerNodes.end(), idx) != lowerNodes.end();
+  };
+  for (size_t first = 0; first < borderPortals.size();)
+  {
+    size_t last = first;
+    while (last + 1 < borderPortals.size() && portal_from(borderPortals[last + 1]) == portal_to(borderPortals[last]) + 1)
+      last++;
+    const size_t middle = portal_from(borderPortals[first]) + portal_to(borderPortals[last]);
+    uint32_t best = borderPortals[first];
+    size_t bestDist = std::numeric_limits<size_t>::max();
+    for (size_t i = first; i <= last; ++i)
+    {
+      const uint32_t idx = borderPortals[i];
+      const size_t center = portal_from(idx) + portal_to(idx);
+      const size_t dist = center > middle ? center - middle : middle - center;
+      if (dist < bestDist && is_lower_node(idx))
       {
-        for (const PathPortal &portal : new_portals)
-        {
-          size_t idx = portals.size();
-          portals.push_back(portal);
-          tilePortalsIndices[y * width + x].push_back(idx);
-          tilePortalsIndices[(y + offs_y) * width + x + offs_x].push_back(idx);
-        }
-      };
-      for (size_t y = 0; y < height; ++y)
-        for (size_t x = 0; x < width; ++x)
-        {
-          tilePortalsIndices.push_back(std::vector<size_t>{});
-          // check top
-          if (y > 0)
-          {
-            std::vector<PathPortal> topPortals;
-            check_border(x, y, 1, 0, 0, -1, topPortals);
-            push_portals(x, y, 0, -1, topPortals);
-          }
-          // left
-          if (x > 0)
-          {
-            std::vector<PathPortal> leftPortals;
-            check_border(x, y, 0, 1, -1, 0, leftPortals);
-            push_portals(x, y, -1, 0, leftPortals);
-          }
-        }
-      for (size_t tidx = 0; tidx < tilePortalsIndices.size(); ++tidx)
+        bestDist = dist;
+        best = idx;
+      }
+    }
+    res.push_back(best);
+    first = last + 1;
+  }
+}
+
+static void get_cluster_nodes(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t cluster,
+                              std::vector<uint32_t> &res)
+{
+  res.clear();
+  const size_t clustersWidth = get_clusters_width(dd, get_level_split(dp, level));
+  const size_t clustersHeight = get_clusters_height(dd, get_level_split(dp, level));
+  const size_t x = cluster % clustersWidth;
+  const size_t y = cluster / clustersWidth;
+  if (y > 0)
+    get_border_nodes(dd, dp, level, cluster, true, res);
+  if (x > 0)
+    get_border_nodes(dd, dp, level, cluster, false, res);
+  if (y + 1 < clustersHeight)
+    get_border_nodes(dd, dp, level, cluster + clustersWidth, true, res);
+  if (x + 1 < clustersWidth)
+    get_border_nodes(dd, dp, level, cluster + 1, false, res);
+}
+
+// connect_cluster_portals of the coarser levels, Dijkstra from every node over the level below,
+// only through its clusters inside of this one. Stops when the rest of the nodes are reached,
+// node_order is a scratch array by portal index, it's left zeroed.
+static void connect_cluster_nodes(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t cluster,
+                                  AStarContext &ctx, std::vector<uint32_t> &node_order,
+                                  std::vector<ClusterConnection> &res)
+{
+  const std::span<const uint32_t> nodes = get_cluster_portals(dp, level, cluster);
+  node_order.resize(dp.portals.size());
+  for (size_t i = 0; i < nodes.size(); ++i)
+    node_order[nodes[i]] = uint32_t(i + 1);
+  for (size_t i = 0; i + 1 < nodes.size(); ++i)
+  {
+    size_t nodesLeft = nodes.size() - i - 1;
+    // sized by capacity, so a context kept between repairs isn't reallocated for every added portal
+    ctx.begin_query(dp.portals.capacity(), 1);
+    ctx.push(nodes[i], 0.f, 0.f, AStarContext::invalid_idx);
+    while (!ctx.empty() && nodesLeft > 0)
+    {
+      const uint32_t cur = ctx.pop();
+      ctx.close(cur);
+      if (node_order[cur] > i + 1)
+        nodesLeft--;
+      const float curG = ctx.get_g(cur);
+      for (const PortalConnection &conn : get_portal_conns(dp, level - 1, cur))
       {
-        const std::vector<size_t> &indices = tilePortalsIndices[tidx];
-        size_t x = tidx % width;
-        size_t y = tidx / width;
-        IVec2 limMin{int((x + 0) * splitTiles), int((y + 0) * splitTiles)};
-        IVec2 limMax{int((x + 1) * splitTiles), int((y + 1) * splitTiles)};
-        for (size_t i = 0; i < indices.size(); ++i)
-        {
-          PathPortal &firstPortal = portals[indices[i]];
-          for (size_t j = i + 1; j < indices.size(); ++j)
-          {
-            PathPortal &secondPortal = portals[indices[j]];
-            // check path from i to j
-            // check each position (to find closest dist) (could be made more optimal)
-            bool noPath = false;
-            size_t minDist = 0xffffffff;
-            for (size_t fromY = std::max(firstPortal.startY, size_t(limMin.y));
-                        fromY <= std::min(firstPortal.endY, size_t(limMax.y - 1)) && !noPath; ++fromY)
-            {
-              for (size_t fromX = std::max(firstPortal.startX, size_t(limMin.x));
-                          fromX <= std::min(firstPortal.endX, size_t(limMax.x - 1)) && !noPath; ++fromX)
-              {
-                for (size_t toY = std::max(secondPortal.startY, size_t(limMin.y));
-                            toY <= std::min(secondPortal.endY, size_t(limMax.y - 1)) && !noPath; ++toY)
-                {
-                  for (size_t toX = std::max(secondPortal.startX, size_t(limMin.x));
-                              toX <= std::min(secondPortal.endX, size_t(limMax.x - 1)) && !noPath; ++toX)
-                  {
-                    IVec2 from{int(fromX), int(fromY)};
-                    IVec2 to{int(toX), int(toY)};
-                    std::vector<IVec2> path = find_path_a_star(dd, from, to, limMin, limMax);
-                    if (path.empty() && from != to)
-                    {
-                      noPath = true; // if we found that there's no path at all - we can break out
-                      break;
-                    }
-                    minDist = std::min(minDist, path.size());
-                  }
-                }
-              }
-            }
-            // write pathable data and length
-            if (noPath)
-              continue;
-            firstPortal.conns.push_back({indices[j], float(minDist)});
-            secondPortal.conns.push_back({indices[i], float(minDist)});
-          }
-        }
+        const uint32_t next = conn.connIdx;
+        if (ctx.is_closed(next) || get_parent_cluster(dd, dp, level - 1, conn.clusterIdx) != cluster)
+          continue;
+        const float gScore = curG + conn.score;
+        if (gScore < ctx.get_g(next))
+          ctx.push(next, gScore, gScore, cur);
       }
-      e.set(DungeonPortals{splitTiles, portals, tilePortalsIndices});
+    }
+    for (size_t j = i + 1; j < nodes.size(); ++j)
+    {
+      if (!ctx.is_closed(nodes[j]))
+        continue;
+      const float score = ctx.get_g(nodes[j]);
+      res.push_back({nodes[i], {nodes[j], score, uint32_t(cluster)}});
+      res.push_back({nodes[j], {nodes[i], score, uint32_t(cluster)}});
+    }
+  }
+  for (uint32_t idx : nodes)
+    node_order[idx] = 0;
+}
+
+DungeonPortals build_dungeon_portals(const DungeonData &dd, const std::vector<size_t> &cluster_sizes,
+                                     size_t num_threads)
+{
+  const size_t split_tiles = cluster_sizes.front();
+  // go through each super tile
+  const size_t width = get_clusters_width(dd, split_tiles);
+  const size_t height = get_clusters_height(dd, split_tiles);
+
+  DungeonPortals dp;
+  dp.levels.push_back(PortalLevel{split_tiles, {}, {}, {}, {}, {}, {}, 0, 0});
+  std::vector<RowItem<uint32_t>> clusterPortals;
+
+  auto push_portals = [&](size_t x, size_t y,
+                          int offs_x, int offs_y,
+                          const std::vector<PathPortal> &new_portals)
+  {
+    for (const PathPortal &portal : new_portals)
+    {
+      const uint32_t idx = uint32_t(dp.portals.size());
+      dp.portals.push_back(portal);
+      clusterPortals.push_back({uint32_t(y * width + x), idx});
+      clusterPortals.push_back({uint32_t(int(y * width + x) + offs_y * int(width) + offs_x), idx});
+    }
+  };
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
+    {
+      // check top
+      if (y > 0)
+      {
+        std::vector<PathPortal> topPortals;
+        check_border(dd, split_tiles, x, y, 1, 0, 0, -1, topPortals);
+        push_portals(x, y, 0, -1, topPortals);
+      }
+      // left
+      if (x > 0)
+      {
+        std::vector<PathPortal> leftPortals;
+        check_border(dd, split_tiles, x, y, 0, 1, -1, 0, leftPortals);
+        push_portals(x, y, -1, 0, leftPortals);
+      }
+    }
+  fill_rows(dp.levels[0].clusterOffsets, dp.levels[0].clusterEnds, dp.levels[0].clusterPortals, width * height,
+            clusterPortals);
+
+  num_threads = get_num_threads(num_threads);
+
+  // clusters are independent, workers grab them one by one
+  std::vector<std::vector<ClusterConnection>> clusterConns(width * height);
+  std::atomic<size_t> nextCluster = 0;
+  run_workers(std::min(num_threads, std::max(clusterConns.size(), size_t(1))), [&]()
+  {
+    std::vector<uint32_t> dist;
+    std::vector<uint32_t> queue;
+    for (size_t tidx = nextCluster++; tidx < clusterConns.size(); tidx = nextCluster++)
+    {
+      IVec2 limMin, limMax;
+      get_cluster_limits(dd, split_tiles, tidx, limMin, limMax);
+      connect_cluster_portals(dd, limMin, limMax, tidx, get_cluster_portals(dp, 0, tidx), dp.portals,
+                              dist, queue, clusterConns[tidx]);
+    }
+  });
+
+  // merge in cluster order, so result doesn't depend on the number of threads
+  std::vector<ClusterConnection> conns;
+  for (const std::vector<ClusterConnection> &cc : clusterConns)
+    conns.insert(conns.end(), cc.begin(), cc.end());
+  fill_rows(dp.levels[0].connOffsets, dp.levels[0].connEnds, dp.levels[0].conns, dp.portals.size(), conns);
+
+  for (size_t i = 1; i < cluster_sizes.size(); ++i)
+  {
+    const size_t prevSplit = get_level_split(dp, dp.levels.size() - 1);
+    const size_t split = (cluster_sizes[i] + prevSplit - 1) / prevSplit * prevSplit;
+    if (split == prevSplit)
+      continue;
+    const size_t numClusters = get_clusters_width(dd, split) * get_clusters_height(dd, split);
+    if (numClusters == 1)
+      break;
+    const size_t level = dp.levels.size();
+    dp.levels.push_back(PortalLevel{split, {}, {}, {}, {}, {}, {}, 0, 0});
+    PortalLevel &pl = dp.levels.back();
+    std::vector<uint32_t> nodes;
+    clusterPortals.clear();
+    for (size_t cluster = 0; cluster < numClusters; ++cluster)
+    {
+      get_cluster_nodes(dd, dp, level, cluster, nodes);
+      for (uint32_t idx : nodes)
+        clusterPortals.push_back({uint32_t(cluster), idx});
+    }
+    fill_rows(pl.clusterOffsets, pl.clusterEnds, pl.clusterPortals, numClusters, clusterPortals);
+
+    clusterConns.assign(numClusters, std::vector<ClusterConnection>{});
+    nextCluster = 0;
+    run_workers(std::min(num_threads, numClusters), [&]()
+    {
+      AStarContext ctx;
+      std::vector<uint32_t> nodeOrder;
+      for (size_t cluster = nextCluster++; cluster < numClusters; cluster = nextCluster++)
+        connect_cluster_nodes(dd, dp, level, cluster, ctx, nodeOrder, clusterConns[cluster]);
+    });
+    conns.clear();
+    for (const std::vector<ClusterConnection> &cc : clusterConns)
+      conns.insert(conns.end(), cc.begin(), cc.end());
+    fill_rows(pl.connOffsets, pl.connEnds, pl.conns, dp.portals.size(), conns);
+  }
+  return dp;
+}
+
+void prebuild_map(flecs::world &ecs, const char *cache_dir)
+{
+  auto mapQuery = ecs.query<const DungeonData>();
+
+  const std::vector<size_t> clusterSizes = {8, 64, 512};
+  ecs.defer([&]()
+  {
+    mapQuery.each([&](flecs::entity e, const DungeonData &dd)
+    {
+      DungeonPortals dp;
+      MapRegions regions;
+      NavCache cache;
+      const std::string cachePath = cache_dir ? NavCache::get_path(cache_dir, dd) : std::string();
+      if (cache_dir && cache.open(cachePath.c_str()) && cache.matches(dd, clusterSizes))
+      {
+        cache.load_portals(dp);
+        cache.load_regions(regions);
+      }
+      else
+      {
+        cache.close();
+        dp = build_dungeon_portals(dd, clusterSizes);
+        regions.build(dd.tiles.data(), dd.width, dd.height);
+        if (cache_dir)
+          NavCache::save(cachePath.c_str(), dd, dp, clusterSizes, regions);
+      }
+      e.set(dp);
+      e.set(regions);
+      e.set(PortalRepairContext{});
+    });
+  });
+}
+
+// Redetects portals on the top (or left) border of the cluster, reusing indices of the old ones.
+// Portal lists of both clusters are edited in place, they're written back after all borders are done.
+// Returns true if a portal of the border moved, appeared or disappeared.
+static bool rebuild_border(DungeonPortals &dp, const DungeonData &dd, size_t cluster, bool top,
+                           std::vector<uint32_t> &cluster_portals, std::vector<uint32_t> &neighbour_portals)
+{
+  const size_t split = get_level_split(dp, 0);
+  const size_t width = get_clusters_width(dd, split);
+  const size_t x = cluster % width;
+  const size_t y = cluster / width;
+
+  // portals which are shared with the neighbour lie exactly on this border
+  std::vector<uint32_t> oldPortals;
+  for (uint32_t idx : cluster_portals)
+    if (std::find(neighbour_portals.begin(), neighbour_portals.end(), idx) != neighbour_portals.end())
+      oldPortals.push_back(idx);
+
+  std::vector<PathPortal> newPortals;
+  if (top)
+    check_border(dd, split, x, y, 1, 0, 0, -1, newPortals);
+  else
+    check_border(dd, split, x, y, 0, 1, -1, 0, newPortals);
+
+  bool moved = newPortals.size() != oldPortals.size();
+  for (size_t i = 0; i < newPortals.size(); ++i)
+  {
+    if (i < oldPortals.size())
+    {
+      const PathPortal &old = dp.portals[oldPortals[i]];
+      moved |= old.startX != newPortals[i].startX || old.startY != newPortals[i].startY ||
+               old.endX != newPortals[i].endX || old.endY != newPortals[i].endY;
+      dp.portals[oldPortals[i]] = newPortals[i];
+      continue;
+    }
+    uint32_t idx = uint32_t(dp.portals.size());
+    if (!dp.freePortals.empty())
+    {
+      idx = dp.freePortals.back();
+      dp.freePortals.pop_back();
+      dp.portals[idx] = newPortals[i];
+    }
+    else
+      dp.portals.push_back(newPortals[i]);
+    cluster_portals.push_back(idx);
+    neighbour_portals.push_back(idx);
+  }
+  for (size_t i = newPortals.size(); i < oldPortals.size(); ++i)
+  {
+    const uint32_t idx = oldPortals[i];
+    dp.portals[idx] = PathPortal{};
+    dp.freePortals.push_back(idx);
+    cluster_portals.erase(std::find(cluster_portals.begin(), cluster_portals.end(), idx));
+    neighbour_portals.erase(std::find(neighbour_portals.begin(), neighbour_portals.end(), idx));
+  }
+  return moved;
+}
+
+static void sort_unique(std::vector<size_t> &v)
+{
+  std::sort(v.begin(), v.end());
+  v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
+// Writes new nodes of the dirty clusters and the connections connect(cluster, nodes, res) makes for them
+// into the rows of the level, only rows of their old and new nodes are touched. Clusters whose portals
+// moved or whose nodes or connections differ from the old ones go to changed, sorted.
+template<typename Connect>
+static void repair_level(DungeonPortals &dp, size_t level, const std::vector<size_t> &dirty_clusters,
+                         const std::vector<std::vector<uint32_t>> &new_nodes, const std::vector<size_t> &moved_clusters,
+                         std::vector<size_t> &changed, Connect connect)
+{
+  PortalLevel &pl = dp.levels[level];
+  changed.clear();
+  // old nodes are kept to find the old connections
+  std::vector<uint32_t> oldNodes;
+  std::vector<size_t> oldNodeOffsets;
+  for (size_t i = 0; i < dirty_clusters.size(); ++i)
+  {
+    const std::span<const uint32_t> nodes = get_cluster_portals(dp, level, dirty_clusters[i]);
+    oldNodeOffsets.push_back(oldNodes.size());
+    oldNodes.insert(oldNodes.end(), nodes.begin(), nodes.end());
+    if (!std::equal(nodes.begin(), nodes.end(), new_nodes[i].begin(), new_nodes[i].end()) ||
+        std::binary_search(moved_clusters.begin(), moved_clusters.end(), dirty_clusters[i]))
+      changed.push_back(dirty_clusters[i]);
+  }
+  oldNodeOffsets.push_back(oldNodes.size());
+  for (size_t i = 0; i < dirty_clusters.size(); ++i)
+    set_row(pl.clusterOffsets, pl.clusterEnds, pl.clusterPortals, pl.clusterHoles, dirty_clusters[i],
+            std::span<const uint32_t>(new_nodes[i]));
+
+  std::vector<ClusterConnection> conns;
+  std::vector<ClusterConnection> oldConns;
+  for (size_t i = 0; i < dirty_clusters.size(); ++i)
+  {
+    connect(dirty_clusters[i], std::span<const uint32_t>(new_nodes[i]), conns);
+    for (size_t j = oldNodeOffsets[i]; j < oldNodeOffsets[i + 1]; ++j)
+      for (const PortalConnection &conn : get_portal_conns(dp, level, oldNodes[j]))
+        if (conn.clusterIdx == dirty_clusters[i])
+          oldConns.push_back({oldNodes[j], conn});
+  }
+
+  // connections of a cluster are compared ordered by both of their ends
+  auto connLess = [](const ClusterConnection &lhs, const ClusterConnection &rhs)
+  {
+    return std::tie(lhs.item.clusterIdx, lhs.row, lhs.item.connIdx) < std::tie(rhs.item.clusterIdx, rhs.row, rhs.item.connIdx);
+  };
+  auto connEqual = [](const ClusterConnection &lhs, const ClusterConnection &rhs)
+  {
+    return lhs.row == rhs.row && lhs.item.connIdx == rhs.item.connIdx && lhs.item.score == rhs.item.score;
+  };
+  std::vector<ClusterConnection> newConns = conns;
+  std::sort(newConns.begin(), newConns.end(), connLess);
+  std::sort(oldConns.begin(), oldConns.end(), connLess);
+  for (size_t cluster : dirty_clusters)
+  {
+    auto inCluster = [&](const std::vector<ClusterConnection> &v)
+    {
+      const ClusterConnection key{0, {0, 0.f, uint32_t(cluster)}};
+      return std::equal_range(v.begin(), v.end(), key, [](const ClusterConnection &lhs, const ClusterConnection &rhs)
+      {
+        return lhs.item.clusterIdx < rhs.item.clusterIdx;
+      });
+    };
+    const auto newRange = inCluster(newConns);
+    const auto oldRange = inCluster(oldConns);
+    if (!std::equal(newRange.first, newRange.second, oldRange.first, oldRange.second, connEqual))
+      changed.push_back(cluster);
+  }
+  sort_unique(changed);
+
+  // connections are stored per cluster, drop only the ones which belong to dirty clusters,
+  // it also drops all connections of removed portals, both of their clusters are dirty
+  std::vector<uint32_t> rows = oldNodes;
+  for (const std::vector<uint32_t> &nodes : new_nodes)
+    rows.insert(rows.end(), nodes.begin(), nodes.end());
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+  std::stable_sort(conns.begin(), conns.end(), [](const ClusterConnection &lhs, const ClusterConnection &rhs) { return lhs.row < rhs.row; });
+  std::vector<PortalConnection> row;
+  size_t next = 0;
+  for (uint32_t idx : rows)
+  {
+    row.clear();
+    for (const PortalConnection &conn : get_portal_conns(dp, level, idx))
+      if (!std::binary_search(dirty_clusters.begin(), dirty_clusters.end(), size_t(conn.clusterIdx)))
+        row.push_back(conn);
+    for (; next < conns.size() && conns[next].row == idx; ++next)
+      row.push_back(conns[next].item);
+    set_row(pl.connOffsets, pl.connEnds, pl.conns, pl.connHoles, idx, std::span<const PortalConnection>(row));
+  }
+
+  // holes are packed lazily, so the cost is spread over many edits
+  if (pl.clusterHoles * 2 > pl.clusterPortals.size())
+    pack_rows(pl.clusterOffsets, pl.clusterEnds, pl.clusterPortals, pl.clusterHoles);
+  if (pl.connHoles * 2 > pl.conns.size())
+    pack_rows(pl.connOffsets, pl.connEnds, pl.conns, pl.connHoles);
+}
+
+void repair_dungeon_portals(DungeonPortals &dp, const DungeonData &dd, const std::vector<IVec2> &changed_tiles,
+                            PortalRepairContext &ctx)
+{
+  const size_t split = get_level_split(dp, 0);
+  const size_t width = get_clusters_width(dd, split);
+  const size_t height = get_clusters_height(dd, split);
+
+  std::vector<size_t> dirtyClusters;
+  std::vector<std::pair<size_t, bool>> dirtyBorders; // cluster and whether it's its top or left border
+  auto add_border = [&](size_t x, size_t y, bool top)
+  {
+    dirtyBorders.push_back({y * width + x, top});
+    dirtyClusters.push_back(y * width + x);
+    dirtyClusters.push_back(top ? (y - 1) * width + x : y * width + x - 1);
+  };
+  for (const IVec2 &tile : changed_tiles)
+  {
+    if (tile.x < 0 || tile.y < 0)
+      continue;
+    const size_t x = size_t(tile.x) / split;
+    const size_t y = size_t(tile.y) / split;
+    // tiles out of the clusters don't participate in portals
+    if (x >= width || y >= height)
+      continue;
+    dirtyClusters.push_back(y * width + x);
+    const size_t localX = size_t(tile.x) % split;
+    const size_t localY = size_t(tile.y) % split;
+    if (localX == 0 && x > 0)
+      add_border(x, y, false);
+    if (localX == split - 1 && x + 1 < width)
+      add_border(x + 1, y, false);
+    if (localY == 0 && y > 0)
+      add_border(x, y, true);
+    if (localY == split - 1 && y + 1 < height)
+      add_border(x, y + 1, true);
+  }
+  std::sort(dirtyBorders.begin(), dirtyBorders.end());
+  dirtyBorders.erase(std::unique(dirtyBorders.begin(), dirtyBorders.end()), dirtyBorders.end());
+  sort_unique(dirtyClusters);
+  if (dirtyClusters.empty())
+    return;
+
+  // both clusters of a dirty border are dirty, so borders only touch these lists
+  std::vector<std::vector<uint32_t>> nodes(dirtyClusters.size());
+  for (size_t i = 0; i < dirtyClusters.size(); ++i)
+  {
+    const std::span<const uint32_t> portals = get_cluster_portals(dp, 0, dirtyClusters[i]);
+    nodes[i].assign(portals.begin(), portals.end());
+  }
+  auto get_dirty_portals = [&](size_t cluster) -> std::vector<uint32_t> &
+  {
+    return nodes[size_t(std::lower_bound(dirtyClusters.begin(), dirtyClusters.end(), cluster) - dirtyClusters.begin())];
+  };
+  // clusters next to borders whose portals moved, levels above have to look at them even if
+  // their connections stay the same, nodes of a coarse border depend on where the portals are
+  std::vector<size_t> movedClusters;
+  for (const auto &border : dirtyBorders)
+  {
+    const size_t neighbour = border.second ? border.first - width : border.first - 1;
+    if (rebuild_border(dp, dd, border.first, border.second, get_dirty_portals(border.first), get_dirty_portals(neighbour)))
+    {
+      movedClusters.push_back(border.first);
+      movedClusters.push_back(neighbour);
+    }
+  }
+  sort_unique(movedClusters);
+  for (PortalLevel &pl : dp.levels)
+    add_rows(pl.connOffsets, pl.connEnds, dp.portals.size());
+
+  std::vector<size_t> changedClusters;
+  repair_level(dp, 0, dirtyClusters, nodes, movedClusters, changedClusters,
+               [&](size_t cluster, std::span<const uint32_t> portals, std::vector<ClusterConnection> &res)
+  {
+    IVec2 limMin, limMax;
+    get_cluster_limits(dd, split, cluster, limMin, limMax);
+    connect_cluster_portals(dd, limMin, limMax, cluster, portals, dp.portals, ctx.dist, ctx.queue, res);
+  });
+
+  // coarser levels: clusters which contain changed ones, their nodes could have changed as well.
+  // A cluster with the same nodes and distances between them changes nothing above it, so repairs stop there.
+  for (size_t level = 1; level < get_num_levels(dp) && !changedClusters.empty(); ++level)
+  {
+    auto to_parents = [&](std::vector<size_t> &clusters)
+    {
+      for (size_t &cluster : clusters)
+        cluster = get_parent_cluster(dd, dp, level - 1, cluster);
+      sort_unique(clusters);
+    };
+    dirtyClusters.swap(changedClusters);
+    to_parents(dirtyClusters);
+    to_parents(movedClusters);
+    nodes.resize(dirtyClusters.size());
+    for (size_t i = 0; i < dirtyClusters.size(); ++i)
+      get_cluster_nodes(dd, dp, level, dirtyClusters[i], nodes[i]);
+    repair_level(dp, level, dirtyClusters, nodes, movedClusters, changedClusters,
+                 [&](size_t cluster, std::span<const uint32_t>, std::vector<ClusterConnection> &res)
+    {
+      connect_cluster_nodes(dd, dp, level, cluster, ctx.portalCtx, ctx.nodeOrder, res);
     });
+  }
+}
+
+void repair_map(flecs::world &ecs, const std::vector<IVec2> &changed_tiles)
+{
+  static auto mapQuery = ecs.query<DungeonPortals, MapRegions, PortalRepairContext, DungeonData>();
+
+  std::vector<size_t> changedIndices;
+  mapQuery.each([&](DungeonPortals &dp, MapRegions &regions, PortalRepairContext &repairCtx, DungeonData &dd)
+  {
+    for (const IVec2 &p : changed_tiles)
+      dd.walkGrid.set_tile(size_t(p.x), size_t(p.y), dd.tiles[coord_to_idx(p.x, p.y, dd.width)]);
+    dd.revision++;
+    repair_dungeon_portals(dp, dd, changed_tiles, repairCtx);
+    changedIndices.clear();
+    for (const IVec2 &p : changed_tiles)
+      changedIndices.push_back(coord_to_idx(p.x, p.y, dd.width));
+    regions.update(dd.tiles.data(), changedIndices);
   });
+
+  // flow fields are cheap to rebuild, just make them stale
+  static auto flowFieldQuery = ecs.query<FlowField>();
+  flowFieldQuery.each([](FlowField &ff) { ff.target = IVec2{-1, -1}; });
 }
 
+size_t get_allocated_bytes(const PortalLevel &pl)
+{
+  return (pl.clusterOffsets.capacity() + pl.clusterEnds.capacity() + pl.clusterPortals.capacity() +
+          pl.connOffsets.capacity() + pl.connEnds.capacity()) * sizeof(uint32_t) +
+         pl.conns.capacity() * sizeof(PortalConnection);
+}
+
+size_t get_allocated_bytes(const DungeonPortals &dp)
+{
+  size_t res = dp.portals.capacity() * sizeof(PathPortal) + dp.freePortals.capacity() * sizeof(uint32_t);
+  for (const PortalLevel &pl : dp.levels)
+    res += get_allocated_bytes(pl);
+  return res;
+}
+
+void print_memory_report(const DungeonPortals &dp)
+{
+  printf("portal graph: %zu portals (%zu free), %zu KiB\n", dp.portals.size(), dp.freePortals.size(),
+         get_allocated_bytes(dp) / 1024);
+  for (size_t level = 0; level < get_num_levels(dp); ++level)
+  {
+    const PortalLevel &pl = dp.levels[level];
+    printf("  level %zu, split %zu: %zu clusters, %zu nodes, %zu connections, %zu KiB\n", level, pl.tileSplit,
+           pl.clusterEnds.size(), pl.clusterPortals.size() - pl.clusterHoles, pl.conns.size() - pl.connHoles,
+           get_allocated_bytes(pl) / 1024);
+  }
+}
@@ -1,26 +1,141 @@
 #pragma once
 #include <flecs.h>
+#include <span>
 #include <vector>
+#include "ecsTypes.h"
+#include "math.h"
+#include "aStarContext.h"
+#include "mapRegions.h"
 
+// Connection to another portal (node) of the same level, 12 bytes.
 struct PortalConnection
 {
-  size_t connIdx;
+  uint32_t connIdx;
   float score;
+  uint32_t clusterIdx; // portals on the same border share two clusters
 };
 
+// Tiles from start to end inclusive, start is on the other side of the border.
+// Coordinates are 16 bit, so maps are at most 65535 tiles across.
 struct PathPortal
 {
-  size_t startX, startY;
-  size_t endX, endY;
+  static constexpr uint16_t removed_coord = 0xffff;
+
+  uint16_t startX = removed_coord, startY = removed_coord;
+  uint16_t endX = removed_coord, endY = removed_coord;
+
+  // slot is in freePortals and could be reused
+  bool is_removed() const { return startX == removed_coord; }
+};
+
+// Level of the hierarchy, clusters of levels above 0 are made of whole clusters of the level below.
+// Nodes of level 0 are all portals between its clusters, nodes of coarser levels are portals on
+// their borders, one per contiguous walkable stretch of a border, and connections are paths
+// over the level below which don't leave the cluster.
+// Both adjacency lists are compressed rows: nodes of cluster c are
+// clusterPortals[clusterOffsets[c]..clusterEnds[c]), connections of portal p
+// are conns[connOffsets[p]..connEnds[p]). Offsets have one more value, the end of the array.
+// Built or loaded rows are packed, each one ends where the next begins. Repairs rewrite a row
+// in place if it doesn't grow and move it to the end of the array otherwise, the space left
+// behind is counted in holes and the rows are packed again once holes take half of the array.
+struct PortalLevel
+{
+  size_t tileSplit;
+  std::vector<uint32_t> clusterOffsets;
+  std::vector<uint32_t> clusterEnds;
+  std::vector<uint32_t> clusterPortals;
+  std::vector<uint32_t> connOffsets; // by portal index
+  std::vector<uint32_t> connEnds;
   std::vector<PortalConnection> conns;
+  size_t clusterHoles = 0;
+  size_t connHoles = 0;
 };
 
+// Clusters cover the whole map, the last row and column are cut by the map edge
+// if its size isn't a multiple of the split.
 struct DungeonPortals
 {
-  size_t tileSplit;
   std::vector<PathPortal> portals;
-  std::vector<std::vector<size_t>> tilePortalsIndices;
+  std::vector<uint32_t> freePortals;
+  std::vector<PortalLevel> levels; // level 0 is the finest one
+};
+
+template<typename T>
+inline size_t coord_to_idx(T x, T y, size_t w)
+{
+  return size_t(y) * w + size_t(x);
+}
+
+float heuristic(IVec2 lhs, IVec2 rhs);
+
+inline size_t get_num_levels(const DungeonPortals &dp) { return dp.levels.size(); }
+inline size_t get_level_split(const DungeonPortals &dp, size_t level) { return dp.levels[level].tileSplit; }
+inline std::span<const uint32_t> get_cluster_portals(const DungeonPortals &dp, size_t level, size_t cluster)
+{
+  const PortalLevel &pl = dp.levels[level];
+  return std::span<const uint32_t>(pl.clusterPortals).subspan(pl.clusterOffsets[cluster],
+                                                              pl.clusterEnds[cluster] - pl.clusterOffsets[cluster]);
+}
+inline std::span<const PortalConnection> get_portal_conns(const DungeonPortals &dp, size_t level, size_t portal)
+{
+  const PortalLevel &pl = dp.levels[level];
+  return std::span<const PortalConnection>(pl.conns).subspan(pl.connOffsets[portal],
+                                                             pl.connEnds[portal] - pl.connOffsets[portal]);
+}
+inline size_t get_clusters_width(const DungeonData &dd, size_t split) { return (dd.width + split - 1) / split; }
+inline size_t get_clusters_height(const DungeonData &dd, size_t split) { return (dd.height + split - 1) / split; }
+void get_cluster_limits(const DungeonData &dd, size_t split, size_t cluster, IVec2 &lim_min, IVec2 &lim_max);
+// cluster of the level above which contains this one
+size_t get_parent_cluster(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t cluster);
+
+// searches are limited to [lim_min, lim_max) rectangle,
+// with regions queries between disconnected tiles return right away
+std::vector<IVec2> find_path_a_star(AStarContext &ctx, const DungeonData &dd, IVec2 from, IVec2 to,
+                                    IVec2 lim_min, IVec2 lim_max, const MapRegions *regions = nullptr);
+// the same, the path is appended to res, false if there's none
+bool find_path_a_star(AStarContext &ctx, const DungeonData &dd, IVec2 from, IVec2 to,
+                      IVec2 lim_min, IVec2 lim_max, std::vector<IVec2> &res, const MapRegions *regions = nullptr);
+// Dijkstra from a tile over the whole rectangle, distances are left in ctx
+void flood_area(AStarContext &ctx, const DungeonData &dd, IVec2 from, IVec2 lim_min, IVec2 lim_max);
+// Appends the path from the start of the last search in ctx to `to`, reading prev links straight
+// from ctx, nothing but res is allocated. without the start tile if with_start is false
+void append_path(const AStarContext &ctx, IVec2 to, size_t width, std::vector<IVec2> &res, bool with_start = true);
+std::vector<IVec2> reconstruct_path(const AStarContext &ctx, IVec2 to, size_t width);
+
+// One level per cluster size, each size is rounded up to a multiple of the previous one,
+// levels which don't grow or would have a single cluster are dropped.
+// num_threads = 0 uses all hardware threads, output doesn't depend on it
+DungeonPortals build_dungeon_portals(const DungeonData &dd, const std::vector<size_t> &cluster_sizes,
+                                     size_t num_threads = 0);
+// Sets DungeonPortals, MapRegions and PortalRepairContext on the dungeon entity. With a cache directory
+// portals and regions are loaded from the cache file of these tiles if there's one, otherwise built and saved there.
+void prebuild_map(flecs::world &ecs, const char *cache_dir = nullptr);
+
+// Scratch of repair_dungeon_portals, kept between repairs so they don't allocate search state.
+struct PortalRepairContext
+{
+  AStarContext portalCtx;
+  std::vector<uint32_t> nodeOrder;
+  std::vector<uint32_t> dist;
+  std::vector<uint32_t> queue;
 };
 
-void prebuild_map(flecs::world &ecs);
+// Recomputes border portals and connections only for clusters touched by the changed tiles
+// (and their neighbours if a tile lies on a border), coarser levels only for the clusters
+// which contain those, and only while nodes or connections of the clusters below changed.
+// Untouched portals keep their indices, the work is proportional to the touched rows.
+void repair_dungeon_portals(DungeonPortals &dp, const DungeonData &dd, const std::vector<IVec2> &changed_tiles,
+                            PortalRepairContext &ctx);
+// tiles of DungeonData should already have new values, its walk grid is updated here
+void repair_map(flecs::world &ecs, const std::vector<IVec2> &changed_tiles);
+
+// packs rows of the level back, they're in index order and without holes after it
+void pack_portal_level(PortalLevel &pl);
+bool is_packed(const PortalLevel &pl);
+
+// heap memory taken by the portal graph, capacities included
+size_t get_allocated_bytes(const PortalLevel &pl);
+size_t get_allocated_bytes(const DungeonPortals &dp);
+// node, edge and byte counts per level
+void print_memory_report(const DungeonPortals &dp);
 
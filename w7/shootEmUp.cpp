@@ -6,6 +6,9 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include "pathfinder.h"
+#include "hpaPathfinder.h"
+#include "pathCache.h"
+#include "flowField.h"
 
 constexpr float tile_size = 64.f;
 
@@ -65,8 +68,8 @@ static void register_roguelike_systems(flecs::world &ecs)
         while (ms.timeToSpawn < 0.f)
         {
           steer::Type st = steer::Type(GetRandomValue(0, steer::Type::Num - 1));
-          const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
-          const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f};
+          const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN, ORANGE, PURPLE};
+          const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f, 800.f, 800.f};
           const float dist = distances[st];
           constexpr int angRandMax = 1 << 16;
           const float angle = float(GetRandomValue(0, angRandMax)) / float(angRandMax) * PI * 2.f;
@@ -79,30 +82,34 @@ static void register_roguelike_systems(flecs::world &ecs)
     });
 
   static auto cameraQuery = ecs.query<const Camera2D>();
-  ecs.system<const DungeonPortals, const DungeonData>()
-    .each([&](const DungeonPortals &dp, const DungeonData &dd)
+  ecs.system<const DungeonPortals, const MapRegions, const DungeonData>()
+    .each([&](const DungeonPortals &dp, const MapRegions &regions, const DungeonData &dd)
     {
-      size_t w = dd.width;
-      size_t ts = dp.tileSplit;
-      for (size_t y = 0; y < dd.height / ts; ++y)
-        DrawLineEx(Vector2{0.f, y * ts * tile_size},
-                   Vector2{dd.width * tile_size, y * ts * tile_size}, 1.f, GetColor(0xff000080));
-      for (size_t x = 0; x < dd.width / ts; ++x)
-        DrawLineEx(Vector2{x * ts * tile_size, 0.f},
-                   Vector2{x * ts * tile_size, dd.height * tile_size}, 1.f, GetColor(0xff000080));
+      size_t ts = get_level_split(dp, 0);
+      // borders of coarser levels are thicker
+      for (size_t level = 0; level < get_num_levels(dp); ++level)
+      {
+        const size_t split = get_level_split(dp, level);
+        for (size_t y = 0; y < get_clusters_height(dd, split); ++y)
+          DrawLineEx(Vector2{0.f, y * split * tile_size},
+                     Vector2{dd.width * tile_size, y * split * tile_size}, 1.f + level * 2.f, GetColor(0xff000080));
+        for (size_t x = 0; x < get_clusters_width(dd, split); ++x)
+          DrawLineEx(Vector2{x * split * tile_size, 0.f},
+                     Vector2{x * split * tile_size, dd.height * tile_size}, 1.f + level * 2.f, GetColor(0xff000080));
+      }
       cameraQuery.each([&](Camera2D cam)
       {
         Vector2 mousePosition = GetScreenToWorld2D(GetMousePosition(), cam);
-        size_t wd = w / ts;
-        for (size_t y = 0; y < dd.height / ts; ++y)
+        size_t wd = get_clusters_width(dd, ts);
+        for (size_t y = 0; y < get_clusters_height(dd, ts); ++y)
         {
           if (mousePosition.y < y * ts * tile_size || mousePosition.y > (y + 1) * ts * tile_size)
             continue;
-          for (size_t x = 0; x < dd.width / ts; ++x)
+          for (size_t x = 0; x < wd; ++x)
           {
             if (mousePosition.x < x * ts * tile_size || mousePosition.x > (x + 1) * ts * tile_size)
               continue;
-            for (size_t idx : dp.tilePortalsIndices[y * wd + x])
+            for (uint32_t idx : get_cluster_portals(dp, 0, y * wd + x))
             {
               const PathPortal &portal = dp.portals[idx];
               Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
@@ -112,8 +119,11 @@ static void register_roguelike_systems(flecs::world &ecs)
             }
           }
         }
-        for (const PathPortal &portal : dp.portals)
+        for (size_t portalIdx = 0; portalIdx < dp.portals.size(); ++portalIdx)
         {
+          const PathPortal &portal = dp.portals[portalIdx];
+          if (portal.is_removed())
+            continue;
           Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
                          (portal.endX - portal.startX + 1) * tile_size,
                          (portal.endY - portal.startY + 1) * tile_size};
@@ -123,7 +133,7 @@ static void register_roguelike_systems(flecs::world &ecs)
               mousePosition.y < rect.y || mousePosition.y > rect.y + rect.height)
             continue;
           DrawRectangleLinesEx(rect, 4, WHITE);
-          for (const PortalConnection &conn : portal.conns)
+          for (const PortalConnection &conn : get_portal_conns(dp, 0, portalIdx))
           {
             const PathPortal &endPortal = dp.portals[conn.connIdx];
             Vector2 toCenter{(endPortal.startX + endPortal.endX + 1) * tile_size * 0.5f,
@@ -135,6 +145,21 @@ static void register_roguelike_systems(flecs::world &ecs)
                      16, WHITE);
           }
         }
+        // hierarchical path from the player to the mouse cursor
+        playerPosQuery.each([&](const Position &pp, const IsPlayer &)
+        {
+          static HierarchicalSearchContext hpaCtx;
+          // the same query is repeated every frame until the player or the cursor moves
+          static PathCache pathCache;
+          const IVec2 from{int((pp.x + tile_size * 0.5f) / tile_size), int((pp.y + tile_size * 0.5f) / tile_size)};
+          const IVec2 to{int(floorf(mousePosition.x / tile_size)), int(floorf(mousePosition.y / tile_size))};
+          const std::vector<IVec2> path = pathCache.get_path(from, to, dd.revision, [&](IVec2 a, IVec2 b)
+          {
+            return find_path_hierarchical(hpaCtx, dd, dp, a, b, &regions);
+          });
+          for (const IVec2 &p : path)
+            DrawRectangleRec(Rectangle{p.x * tile_size, p.y * tile_size, tile_size, tile_size}, GetColor(0x44000088));
+        });
       });
     });
   steer::register_systems(ecs);
@@ -154,7 +179,7 @@ void init_shoot_em_up(flecs::world &ecs)
   create_player(ecs, walkableTile * tile_size, "swordsman_tex");
 }
 
-void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
+void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h, const char *nav_cache_dir)
 {
   flecs::entity wallTex = ecs.entity("wall_tex")
     .set(Texture2D{LoadTexture("assets/wall.png")});
@@ -166,8 +191,13 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
       dungeonData[y * w + x] = tiles[y * w + x];
+  DungeonData dd{dungeonData, w, h, {}};
+  dd.walkGrid.build(tiles, w, h);
+  FlowField flowField;
+  flowField.tileSize = tile_size;
   ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
+    .set(dd)
+    .set(flowField);
 
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
@@ -182,10 +212,56 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
       else if (tile == dungeon::floor)
         tileEntity.add<TextureSource>(floorTex);
     }
-  prebuild_map(ecs);
+  prebuild_map(ecs, nav_cache_dir);
+}
+
+// Middle mouse button or Q digs the wall under the cursor or builds one there, like tile edits
+// of the pathfinding demo. Portals, regions and flow fields are repaired around the tile.
+static void edit_tile(flecs::world &ecs)
+{
+  static auto cameraQuery = ecs.query<const Camera2D>();
+  static auto dungeonDataQuery = ecs.query<DungeonData>();
+  static auto backgroundQuery = ecs.query<const Position, const BackgroundTile>();
+
+  if (!IsMouseButtonPressed(2) && !IsKeyPressed(KEY_Q))
+    return;
+  std::vector<IVec2> changedTiles;
+  char newTile = dungeon::wall;
+  cameraQuery.each([&](const Camera2D &cam)
+  {
+    const Vector2 mousePosition = GetScreenToWorld2D(GetMousePosition(), cam);
+    const IVec2 tile{int(floorf(mousePosition.x / tile_size)), int(floorf(mousePosition.y / tile_size))};
+    dungeonDataQuery.each([&](DungeonData &dd)
+    {
+      // the map edge stays a wall
+      if (tile.x <= 0 || tile.y <= 0 || tile.x + 1 >= int(dd.width) || tile.y + 1 >= int(dd.height))
+        return;
+      char &c = dd.tiles[coord_to_idx(tile.x, tile.y, dd.width)];
+      c = c == dungeon::wall ? dungeon::floor : dungeon::wall;
+      newTile = c;
+      changedTiles.push_back(tile);
+    });
+  });
+  if (changedTiles.empty())
+    return;
+  repair_map(ecs, changedTiles);
+
+  const Position tilePos{float(changedTiles[0].x) * tile_size, float(changedTiles[0].y) * tile_size};
+  flecs::entity tileEntity;
+  backgroundQuery.each([&](flecs::entity e, const Position &pos, const BackgroundTile &)
+  {
+    if (pos == tilePos)
+      tileEntity = e;
+  });
+  if (!tileEntity)
+    return;
+  const bool isWall = newTile == dungeon::wall;
+  tileEntity.remove<TextureSource>(ecs.lookup(isWall ? "floor_tex" : "wall_tex"))
+    .add<TextureSource>(ecs.lookup(isWall ? "wall_tex" : "floor_tex"));
 }
 
 void process_game(flecs::world &ecs)
 {
+  edit_tile(ecs);
 }
 
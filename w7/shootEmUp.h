@@ -3,5 +3,6 @@
 
 void init_shoot_em_up(flecs::world &ecs);
 void process_game(flecs::world &ecs);
-void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h);
+// navigation data is cached in nav_cache_dir if it's set, see prebuild_map
+void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h, const char *nav_cache_dir = nullptr);
 
@@ -1,10 +1,24 @@
 #include "steering.h"
 #include "ecsTypes.h"
+#include "flowField.h"
+#include "pathBatch.h"
+#include "compactPath.h"
+#include <cstdlib>
 
 struct Seeker {};
 struct Pursuer {};
 struct Evader {};
 struct Fleer {};
+struct FlowSeeker {};
+// A path to the player is followed for long, so it's kept compact. It's planned again when
+// the player gets to another tile, the map changes or the seeker is pushed off the path.
+struct PathSeeker
+{
+  CompactPath path;
+  CompactPathCursor cursor;
+  IVec2 target{-1, -1};
+  uint32_t revision = 0;
+};
 struct Separation {};
 struct Alignment {};
 struct Cohesion {};
@@ -55,6 +69,16 @@ flecs::entity steer::create_fleer(flecs::entity e)
   return create_steerer(e).add<Fleer>();
 }
 
+flecs::entity steer::create_flow_seeker(flecs::entity e)
+{
+  return create_steerer(e).add<FlowSeeker>();
+}
+
+flecs::entity steer::create_path_seeker(flecs::entity e)
+{
+  return create_steerer(e).set(PathSeeker{});
+}
+
 typedef flecs::entity (*create_foo)(flecs::entity);
 
 flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
@@ -64,7 +88,9 @@ flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
     create_seeker,
     create_pursuer,
     create_evader,
-    create_fleer
+    create_fleer,
+    create_flow_seeker,
+    create_path_seeker
   };
   return steerFoo[type](e);
 }
@@ -116,6 +142,111 @@ void steer::register_systems(flecs::world &ecs)
       });
     });
 
+  // flow field towards the player, rebuilt only when the player gets to another tile
+  static auto flowFieldQuery = ecs.query<FlowField, const DungeonData>();
+  ecs.system<const Position, const IsPlayer>()
+    .each([&](const Position &pp, const IsPlayer &)
+    {
+      flowFieldQuery.each([&](FlowField &ff, const DungeonData &dd)
+      {
+        const IVec2 tile = get_flow_field_tile(ff, pp);
+        if (tile != ff.target)
+          build_flow_field(ff, dd, tile);
+      });
+    });
+
+  // flow seeker, goes around walls by the flow field, seeks directly where the field can't help
+  static auto flowQuery = ecs.query<const FlowField>();
+  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const FlowSeeker>()
+    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const FlowSeeker &)
+    {
+      flowQuery.each([&](const FlowField &ff)
+      {
+        Position dir;
+        if (sample_flow_field(ff, p, dir) && dir != Position{0.f, 0.f})
+        {
+          sd += SteerDir{dir * ms.speed - vel};
+          return;
+        }
+        playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
+        {
+          sd += SteerDir{normalize(pp - p) * ms.speed - vel};
+        });
+      });
+    });
+
+  // path seekers which need a new path get it all at once, in one batch over worker threads
+  static auto pathSeekerQuery = ecs.query<PathSeeker, const Position>();
+  static auto navQuery = ecs.query<const DungeonData, const DungeonPortals, const MapRegions, const FlowField>();
+  ecs.system<const Position, const IsPlayer>()
+    .each([&](const Position &pp, const IsPlayer &)
+    {
+      navQuery.each([&](const DungeonData &dd, const DungeonPortals &dp, const MapRegions &regions,
+                        const FlowField &ff)
+      {
+        static PathBatchContext batchCtx;
+        static std::vector<PathSeeker *> seekers;
+        static std::vector<PathRequest> requests;
+        static std::vector<PathResult> results;
+        static std::vector<IVec2> arena;
+        const IVec2 target = get_flow_field_tile(ff, pp);
+        seekers.clear();
+        requests.clear();
+        pathSeekerQuery.each([&](PathSeeker &ps, const Position &p)
+        {
+          const IVec2 tile = get_flow_field_tile(ff, p);
+          const bool isLost = ps.path.length > 0 && abs(tile.x - ps.cursor.pos.x) + abs(tile.y - ps.cursor.pos.y) > 1;
+          if (ps.target == target && ps.revision == dd.revision && !isLost)
+            return;
+          seekers.push_back(&ps);
+          requests.push_back(PathRequest{tile, target});
+        });
+        if (requests.empty())
+          return;
+        results.resize(requests.size());
+        const size_t numTiles = find_paths(batchCtx, dd, dp, &regions, requests, results, arena);
+        if (numTiles > arena.size())
+        {
+          // the arena keeps the size of the largest batch
+          arena.resize(numTiles);
+          find_paths(batchCtx, dd, dp, &regions, requests, results, arena);
+        }
+        for (size_t i = 0; i < seekers.size(); ++i)
+        {
+          PathSeeker &ps = *seekers[i];
+          const PathResult &result = results[i];
+          ps.target = target;
+          ps.revision = dd.revision;
+          ps.path = CompactPath{};
+          if (result.status == PathResult::Status::Found)
+            encode_path(std::span<const IVec2>(arena).subspan(result.offset, result.length), ps.path);
+          ps.cursor = CompactPathCursor(ps.path);
+        }
+      });
+    });
+
+  // path seeker, steps to the next tile of its path, seeks directly where the path can't help
+  ecs.system<SteerDir, PathSeeker, const MoveSpeed, const Velocity, const Position>()
+    .each([&](SteerDir &sd, PathSeeker &ps, const MoveSpeed &ms, const Velocity &vel, const Position &p)
+    {
+      flowQuery.each([&](const FlowField &ff)
+      {
+        const IVec2 tile = get_flow_field_tile(ff, p);
+        if (tile == ps.cursor.pos)
+          ps.cursor.advance(ps.path);
+        if (ps.path.length > 0 && tile != ps.cursor.pos)
+        {
+          const Position tilePos{float(ps.cursor.pos.x) * ff.tileSize, float(ps.cursor.pos.y) * ff.tileSize};
+          sd += SteerDir{normalize(tilePos - p) * ms.speed - vel};
+          return;
+        }
+        playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
+        {
+          sd += SteerDir{normalize(pp - p) * ms.speed - vel};
+        });
+      });
+    });
+
   // evader
   ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Evader>()
     .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Evader &)
@@ -9,6 +9,8 @@ namespace steer
     StPursuer,
     StEvader,
     StFleer,
+    StFlowSeeker,
+    StPathSeeker,
     Num
   };
 
@@ -18,6 +20,8 @@ namespace steer
   flecs::entity create_pursuer(flecs::entity e);
   flecs::entity create_evader(flecs::entity e);
   flecs::entity create_fleer(flecs::entity e);
+  flecs::entity create_flow_seeker(flecs::entity e);
+  flecs::entity create_path_seeker(flecs::entity e);
 
   void register_systems(flecs::world &ecs);
 };
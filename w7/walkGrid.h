@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Walkability of the map, 1 bit per tile. Derived from char tiles and 8 times smaller,
+// so large maps stay in cache. Every row starts
+// on a cache line and is padded with unwalkable words, with unwalkable rows above and below,
+// so neighbourhood counts near the edges need no bounds checks.
+class WalkGrid
+{
+public:
+  // padding rows, enough for 5x5 neighbourhoods
+  static constexpr size_t border = 2;
+
+  void build(const char *tiles, size_t width, size_t height);
+  // keeps the grid in sync after a tile edit
+  void set_tile(size_t x, size_t y, char tile);
+
+  size_t get_width() const { return width; }
+  size_t get_height() const { return height; }
+
+  bool is_walkable(int x, int y) const
+  {
+    if (x < 0 || y < 0 || x >= int(width) || y >= int(height))
+      return false;
+    return test(walkable, size_t(x), size_t(y));
+  }
+
+  // Walkable words of the row, the first one is padding,
+  // tile x is the bit (x & 63) of the word (x >> 6) + 1.
+  const uint64_t *get_row(size_t y) const { return &walkable[row_offset(y)]; }
+  size_t get_words_per_row() const { return wordsPerRow; }
+
+  // walkable tiles in [x_from, x_to) of the row
+  size_t count_walkable_in_row(size_t y, size_t x_from, size_t x_to) const;
+  // first walkable tile of the row at or after x, width if there's none
+  size_t find_walkable_in_row(size_t y, size_t x) const;
+  // Walkable tiles in the (2 * radius + 1) square around a tile of the map,
+  // tiles out of the map aren't walkable. radius is at most border.
+  size_t count_walkable_around(size_t x, size_t y, size_t radius) const;
+  // The same for every tile of the row at once, slides a window over column sums,
+  // which is much cheaper when the whole map is processed. counts should hold width values.
+  void count_walkable_around_row(size_t y, size_t radius, uint8_t *counts) const;
+
+  size_t get_allocated_bytes() const { return walkable.capacity() * sizeof(uint64_t); }
+
+private:
+  template<typename T>
+  struct CacheLineAllocator
+  {
+    using value_type = T;
+    CacheLineAllocator() = default;
+    template<typename U>
+    CacheLineAllocator(const CacheLineAllocator<U> &) {}
+    T *allocate(size_t n) { return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{64})); }
+    void deallocate(T *p, size_t) { ::operator delete(p, std::align_val_t{64}); }
+    template<typename U>
+    bool operator==(const CacheLineAllocator<U> &) const { return true; }
+  };
+  using Words = std::vector<uint64_t, CacheLineAllocator<uint64_t>>;
+
+  size_t row_offset(size_t y) const { return (y + border) * wordsPerRow; }
+  bool test(const Words &words, size_t x, size_t y) const
+  {
+    return (words[row_offset(y) + (x >> 6) + 1] >> (x & 63)) & 1;
+  }
+
+  size_t width = 0;
+  size_t height = 0;
+  size_t wordsPerRow = 0;
+  Words walkable;
+};
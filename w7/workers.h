@@ -0,0 +1,22 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// calls worker() on num_threads threads, the current one included
+template<typename Callable>
+void run_workers(size_t num_threads, Callable worker)
+{
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread &t : threads)
+    t.join();
+}
+
+// 0 means all hardware threads
+inline size_t get_num_threads(size_t num_threads)
+{
+  return num_threads > 0 ? num_threads : std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+}